@@ -0,0 +1,413 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <QStringList>
+#include "allocation_tracker.hpp"
+#include "logger.hpp"
+
+#ifdef EMOTE_BUILDER_TRACK_ALLOCATIONS
+
+#if defined(__linux__) && defined(__GLIBC__)
+#define TRACK_MALLOC
+#include <malloc.h>
+#include <unistd.h>
+#endif
+
+static const int maxSites = 64;
+static const int maxPhases = 16;
+static const int maxPhaseName = 32;
+
+// Counters of one site or phase. Statics of atomics are zero before any constructor runs, which matters because
+// allocations start before main.
+class AllocationCounters
+{
+public:
+    std::atomic<long long> allocations;
+    std::atomic<long long> bytes;
+    std::atomic<long long> live;
+    std::atomic<long long> peak;
+};
+
+static AllocationCounters siteCounters[maxSites];
+static AllocationCounters phaseCounters[maxPhases];
+static const char *siteNames[maxSites] = { "other" };
+static int sitePhases[maxSites];
+static char phaseNames[maxPhases][maxPhaseName] = { "other" };
+static int siteCount = 1;
+static int phaseCount = 1;
+static std::mutex registryMutex;
+
+// Site 0 collects allocations outside of every scope
+static thread_local int threadSite = 0;
+
+// Stored in front of every block, keeping the block aligned like the allocator's own blocks
+class BlockHeader
+{
+public:
+    size_t          size;
+    int             site;
+    int             offset; // From the start of the underlying allocation to the block
+};
+
+static const size_t headerSize = 16;
+static_assert(sizeof(BlockHeader) <= headerSize, "The block header must fit the alignment padding");
+
+static void raisePeak(std::atomic<long long> &peak, long long live)
+{
+    long long current = peak.load(std::memory_order_relaxed);
+    while (live > current && !peak.compare_exchange_weak(current, live, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void countAllocation(AllocationCounters &counters, long long size)
+{
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+    raisePeak(counters.peak, counters.live.fetch_add(size, std::memory_order_relaxed) + size);
+}
+
+static void *trackBlock(char *base, size_t offset, size_t size)
+{
+    char *block = base + offset;
+    BlockHeader *header = reinterpret_cast<BlockHeader *>(block - headerSize);
+    header->size = size;
+    header->site = threadSite;
+    header->offset = (int)offset;
+
+    countAllocation(siteCounters[header->site], (long long)size);
+    countAllocation(phaseCounters[sitePhases[header->site]], (long long)size);
+    return block;
+}
+
+static BlockHeader *headerOf(void *block)
+{
+    return reinterpret_cast<BlockHeader *>(static_cast<char *>(block) - headerSize);
+}
+
+// Counts the free and returns the start of the underlying allocation
+static void *untrackBlock(void *block)
+{
+    BlockHeader *header = headerOf(block);
+    siteCounters[header->site].live.fetch_sub((long long)header->size, std::memory_order_relaxed);
+    phaseCounters[sitePhases[header->site]].live.fetch_sub((long long)header->size, std::memory_order_relaxed);
+    return static_cast<char *>(block) - header->offset;
+}
+
+#ifdef TRACK_MALLOC
+
+extern "C"
+{
+void *__libc_malloc(size_t size);
+void *__libc_realloc(void *block, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *block);
+
+void *malloc(size_t size) noexcept
+{
+    char *base = static_cast<char *>(__libc_malloc(size + headerSize));
+    return base ? trackBlock(base, headerSize, size) : nullptr;
+}
+
+void free(void *block) noexcept
+{
+    if (block)
+        __libc_free(untrackBlock(block));
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    if (size != 0 && count > (size_t)-1 / size)
+    {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    void *block = malloc(count * size);
+    if (block)
+        std::memset(block, 0, count * size);
+    return block;
+}
+
+void *memalign(size_t alignment, size_t size) noexcept
+{
+    size_t offset = std::max(headerSize, alignment);
+    char *base = static_cast<char *>(__libc_memalign(alignment, size + offset));
+    return base ? trackBlock(base, offset, size) : nullptr;
+}
+
+void *realloc(void *block, size_t size) noexcept
+{
+    if (!block)
+        return malloc(size);
+    if (size == 0)
+    {
+        free(block);
+        return nullptr;
+    }
+
+    // Aligned blocks lose their alignment in place, so they move
+    BlockHeader *header = headerOf(block);
+    size_t oldSize = header->size;
+    if (header->offset != (int)headerSize)
+    {
+        void *moved = malloc(size);
+        if (moved)
+        {
+            std::memcpy(moved, block, std::min(oldSize, size));
+            free(block);
+        }
+        return moved;
+    }
+
+    int site = header->site;
+    char *base = static_cast<char *>(__libc_realloc(static_cast<char *>(block) - headerSize, size + headerSize));
+    if (!base)
+        return nullptr;
+
+    siteCounters[site].live.fetch_sub((long long)oldSize, std::memory_order_relaxed);
+    phaseCounters[sitePhases[site]].live.fetch_sub((long long)oldSize, std::memory_order_relaxed);
+    return trackBlock(base, headerSize, size);
+}
+
+void *reallocarray(void *block, size_t count, size_t size) noexcept
+{
+    if (size != 0 && count > (size_t)-1 / size)
+    {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(block, count * size);
+}
+
+int posix_memalign(void **block, size_t alignment, size_t size) noexcept
+{
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    *block = memalign(alignment, size);
+    return *block ? 0 : ENOMEM;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    return memalign(alignment, size);
+}
+
+void *valloc(size_t size) noexcept
+{
+    return memalign((size_t)sysconf(_SC_PAGESIZE), size);
+}
+
+void *pvalloc(size_t size) noexcept
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return memalign(page, (size + page - 1) / page * page);
+}
+
+size_t malloc_usable_size(void *block) noexcept
+{
+    return block ? headerOf(block)->size : 0;
+}
+}
+
+#else
+
+// Only the plain forms are replaced. The aligned forms keep their own matching allocator.
+void *operator new(size_t size)
+{
+    char *base = static_cast<char *>(std::malloc(size + headerSize));
+    if (!base)
+        throw std::bad_alloc();
+    return trackBlock(base, headerSize, size);
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    char *base = static_cast<char *>(std::malloc(size + headerSize));
+    return base ? trackBlock(base, headerSize, size) : nullptr;
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *block) noexcept
+{
+    if (block)
+        std::free(untrackBlock(block));
+}
+
+void operator delete[](void *block) noexcept
+{
+    operator delete(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    operator delete(block);
+}
+
+void operator delete[](void *block, size_t) noexcept
+{
+    operator delete(block);
+}
+
+void operator delete(void *block, const std::nothrow_t &) noexcept
+{
+    operator delete(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept
+{
+    operator delete(block);
+}
+
+#endif
+
+bool AllocationTracker::isEnabled()
+{
+    return true;
+}
+
+/// Looks up a site by name, registering it and its phase on first use. Names are compared by content, so the same
+/// literal in two translation units is one site. Past the site limit, allocations count as outside of any scope.
+int AllocationTracker::site(const char *name)
+{
+    std::lock_guard<std::mutex> locker(registryMutex);
+    for (int i = 0; i < siteCount; ++i)
+    {
+        if (std::strcmp(siteNames[i], name) == 0)
+            return i;
+    }
+    if (siteCount == maxSites)
+        return 0;
+
+    const char *separator = std::strchr(name, ':');
+    size_t phaseLength = std::min(separator ? (size_t)(separator - name) : std::strlen(name), (size_t)maxPhaseName - 1);
+    int phase = 0;
+    while (phase < phaseCount && (std::strncmp(phaseNames[phase], name, phaseLength) != 0 || phaseNames[phase][phaseLength] != 0))
+        ++phase;
+    if (phase == phaseCount)
+    {
+        if (phaseCount == maxPhases)
+            return 0;
+        std::memcpy(phaseNames[phase], name, phaseLength);
+        phaseNames[phase][phaseLength] = 0;
+        phaseCount++;
+    }
+
+    siteNames[siteCount] = name;
+    sitePhases[siteCount] = phase;
+    return siteCount++;
+}
+
+int AllocationTracker::currentSite()
+{
+    return threadSite;
+}
+
+void AllocationTracker::setCurrentSite(int site)
+{
+    threadSite = site;
+}
+
+static QString megabytes(long long bytes)
+{
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1);
+}
+
+static QString countersLine(const QString &name, AllocationCounters &counters)
+{
+    return QString("  %1: %2 allocations, %3 MB, peak %4 MB live, %5 MB live now")
+           .arg(name)
+           .arg(counters.allocations.load())
+           .arg(megabytes(counters.bytes.load()))
+           .arg(megabytes(counters.peak.load()))
+           .arg(megabytes(counters.live.load()));
+}
+
+/// Logs the allocations of every phase and site since the previous report, then starts counting anew. Live bytes
+/// carry over, they are what the next phases start from.
+void AllocationTracker::report()
+{
+    std::unique_lock<std::mutex> locker(registryMutex);
+
+    // Taken before the report allocates its own strings
+    int sites = siteCount, phases = phaseCount;
+    std::vector<int> order(sites);
+    for (int i = 0; i < sites; ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [](int siteA, int siteB)
+    {
+        return siteCounters[siteA].bytes.load() > siteCounters[siteB].bytes.load();
+    });
+
+    QStringList lines;
+    lines.append("Allocations by phase since the last report:");
+    for (int phase = 0; phase < phases; ++phase)
+    {
+        if (phaseCounters[phase].allocations.load() > 0)
+            lines.append(countersLine(phaseNames[phase], phaseCounters[phase]));
+    }
+    lines.append("Allocations by site:");
+    for (int site : order)
+    {
+        if (siteCounters[site].allocations.load() > 0)
+            lines.append(countersLine(siteNames[site], siteCounters[site]));
+    }
+
+    for (AllocationCounters &counters : siteCounters)
+    {
+        counters.allocations = 0;
+        counters.bytes = 0;
+        counters.peak = counters.live.load();
+    }
+    for (AllocationCounters &counters : phaseCounters)
+    {
+        counters.allocations = 0;
+        counters.bytes = 0;
+        counters.peak = counters.live.load();
+    }
+
+    locker.unlock();
+    Logger::write(lines.join("\n"));
+}
+
+#else
+
+bool AllocationTracker::isEnabled()
+{
+    return false;
+}
+
+int AllocationTracker::site(const char *)
+{
+    return 0;
+}
+
+int AllocationTracker::currentSite()
+{
+    return 0;
+}
+
+void AllocationTracker::setCurrentSite(int)
+{
+}
+
+void AllocationTracker::report()
+{
+}
+
+#endif
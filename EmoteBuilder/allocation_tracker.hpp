@@ -0,0 +1,51 @@
+#ifndef ALLOCATION_TRACKER_HPP
+#define ALLOCATION_TRACKER_HPP
+
+/// Counts heap allocations by the build phase and container that made them, in builds configured with
+/// EMOTE_BUILDER_TRACK_ALLOCATIONS. Sites are named "phase: container" and phases are summed from their sites.
+/// Allocations count towards the innermost AllocationScope of the allocating thread and frees towards the site the
+/// block was allocated in, so live and peak bytes stay right for blocks that outlive their scope.
+/// On Linux with glibc the malloc family itself is replaced, which also catches the pixels and containers that Qt
+/// allocates with malloc. Elsewhere only operator new and delete are replaced.
+class AllocationTracker
+{
+public:
+    static bool isEnabled();
+    static int site(const char *name);
+    static int currentSite();
+    static void setCurrentSite(int site);
+    static void report();
+};
+
+/// Attributes the allocations of this thread to a site until it goes out of scope. Pool threads start outside of
+/// every scope, so tasks open their own. Compiles to nothing without tracking.
+class AllocationScope
+{
+public:
+#ifdef EMOTE_BUILDER_TRACK_ALLOCATIONS
+    explicit AllocationScope(const char *site)
+        : previousSite(AllocationTracker::currentSite())
+    {
+        AllocationTracker::setCurrentSite(AllocationTracker::site(site));
+    }
+
+    ~AllocationScope()
+    {
+        AllocationTracker::setCurrentSite(previousSite);
+    }
+#else
+    explicit AllocationScope(const char *)
+    {
+    }
+#endif
+
+    AllocationScope(const AllocationScope &) = delete;
+    AllocationScope &operator=(const AllocationScope &) = delete;
+
+#ifdef EMOTE_BUILDER_TRACK_ALLOCATIONS
+private:
+    int             previousSite;
+#endif
+};
+
+#endif // ALLOCATION_TRACKER_HPP
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <utility>
+#include "atlas_layout.hpp"
+
+const FreeRectChoiceHeuristic AtlasLayout::heuristics[AtlasLayout::heuristicCount] = { RectBestAreaFit,
+                                                                                      RectBestLongSideFit,
+                                                                                      RectBestShortSideFit,
+                                                                                      RectBottomLeftRule,
+                                                                                      RectContactPointRule,
+                                                                                    };
+
+const char *const AtlasLayout::heuristicNames[AtlasLayout::heuristicCount] = { "BAF", "BLSF", "BSSF", "BL", "CP" };
+
+AtlasLayout::AtlasLayout(int atlasWidth, int atlasHeight, int maxAtlasCount, bool allowOptimizeSize, bool forceSquare, bool allowRotation)
+{
+    setOptions(atlasWidth, atlasHeight, maxAtlasCount, allowOptimizeSize, forceSquare, allowRotation);
+}
+
+// Changes the bin options of later builds, the packers of earlier builds are kept for reuse
+void AtlasLayout::setOptions(int atlasWidth, int atlasHeight, int maxAtlasCount, bool allowOptimizeSize, bool forceSquare, bool allowRotation)
+{
+    this->atlasWidth = atlasWidth;
+    this->atlasHeight = atlasHeight;
+    this->maxAtlasCount = maxAtlasCount;
+    this->allowOptimizeSize = allowOptimizeSize;
+    this->forceSquare = forceSquare;
+    this->allowRotation = allowRotation;
+}
+
+// Packs in cells of 2^alignShift pixels with gutter extra cells on the right and top of every rect
+void AtlasLayout::setAlignment(int alignShift, int gutter)
+{
+    this->alignShift = alignShift;
+    this->gutter = gutter;
+}
+
+int AtlasLayout::cells(int pixels) const
+{
+    int align = (1 << alignShift) - 1;
+    return ((pixels + align) >> alignShift) + gutter;
+}
+
+/// Packs with every heuristic and keeps the layout that wastes the least bin area. Each heuristic packs into a packer
+/// of the pool, so repeated calls between pool resets allocate nothing once the packers have grown.
+/// @param heuristicMicroseconds [out] If given, receives the packing time of each heuristic in heuristics order.
+/// @return The packer with the best layout, owned by the pool.
+MaxRectsBinPack &AtlasLayout::packBestHeuristic(PackerPool &pool, int width, int height, const std::vector<RectSize> &rects,
+                                                bool allowRotation, bool &allUsed, long long *heuristicMicroseconds)
+{
+    MaxRectsBinPack *bestBinPacker = nullptr;
+    int leastWastedPixels = std::numeric_limits<int>::max();
+    allUsed = false;
+    for (int i = 0; i < heuristicCount; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        MaxRectsBinPack &binPacker = pool.acquire(width, height, allowRotation);
+        bool activeAllUsed = binPacker.insert(rects, heuristics[i]);
+        if (heuristicMicroseconds)
+            heuristicMicroseconds[i] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        int wastedPixels = binPacker.wastedBinArea();
+        if (!bestBinPacker || wastedPixels < leastWastedPixels)
+        {
+            leastWastedPixels = wastedPixels;
+            bestBinPacker = &binPacker;
+            allUsed = activeAllUsed;
+        }
+    }
+
+    return *bestBinPacker;
+}
+
+// Packers take their input by value, so the rects left for the next atlas are recovered from the placed ones
+void AtlasLayout::unplacedRects(const std::vector<RectSize> &rects, const std::vector<Rect> &placed, std::vector<RectSize> &remaining)
+{
+    remaining.assign(rects.begin(), rects.end());
+    for (const Rect &rect : placed)
+    {
+        int matched = -1;
+        for (int i = 0; i < (int)remaining.size() && matched == -1; ++i)
+        {
+            if (remaining[i].width == rect.width && remaining[i].height == rect.height)
+                matched = i;
+        }
+        for (int i = 0; i < (int)remaining.size() && matched == -1; ++i)
+        {
+            if (remaining[i].width == rect.height && remaining[i].height == rect.width)
+                matched = i;
+        }
+
+        if (matched != -1)
+            remaining.erase(remaining.begin() + matched);
+    }
+}
+
+/// Builds the layout with packBestHeuristic.
+/// @return The number of source rects that did not fit.
+int AtlasLayout::build(const std::vector<RectSize> &sourceRects)
+{
+    bool allowRotation = this->allowRotation;
+    return build(sourceRects, [allowRotation](PackerPool &pool, int width, int height, const std::vector<RectSize> &rects,
+                                              bool &allUsed) -> MaxRectsBinPack &
+    {
+        return packBestHeuristic(pool, width, height, rects, allowRotation, allUsed);
+    });
+}
+
+int AtlasLayout::build(const std::vector<RectSize> &sourceRects, const PackFunction &pack)
+{
+    atlases.clear();
+    remainingRectIndices.clear();
+    std::vector<bool> usedRect(sourceRects.size());
+
+    int atlasWidth = this->atlasWidth >> alignShift;
+    int atlasHeight = this->atlasHeight >> alignShift;
+
+    // Sanity check, can't build with textures larger than the actual max atlas size
+    int minSize = std::max(atlasWidth, atlasHeight);
+    int maxSize = std::max(atlasWidth, atlasHeight);
+    for (RectSize rs : sourceRects)
+    {
+        int maxDim = cells(std::max(rs.width, rs.height));
+        int minDim = cells(std::max(rs.width, rs.height));
+
+        // largest texture needs to fit in an atlas
+        if (maxDim > maxSize || (maxDim <= maxSize && minDim > minSize))
+        {
+            remainingRectIndices.clear();
+            for (int i = 0; i < (int)sourceRects.size(); ++i)
+                remainingRectIndices.push_back(i);
+            return (int)remainingRectIndices.size();
+        }
+    }
+
+    // Start with all source rects, this list will get reduced over time
+    std::vector<RectSize> rects;
+    for (RectSize rs : sourceRects)
+    {
+        RectSize t;
+        t.width = cells(rs.width);
+        t.height = cells(rs.height);
+        rects.push_back(t);
+    }
+
+    bool allUsed = false;
+    while (allUsed == false && (int)atlases.size() < maxAtlasCount)
+    {
+        int numPasses = 1;
+        int thisCellW = atlasWidth, thisCellH = atlasHeight;
+        bool reverted = false;
+
+        while (numPasses > 0)
+        {
+            // Packers leave rects untouched, so every pass can try a smaller size on the same rects. The packers of
+            // the previous pass are done with once it has been decided on.
+            pool.reset();
+
+//					MaxRectsBinPack binPacker = new MaxRectsBinPack(thisCellW, thisCellH);
+//					allUsed = binPacker.Insert(currRects, MaxRectsBinPack.FreeRectChoiceHeuristic.RectBestAreaFit);
+            MaxRectsBinPack &binPacker = pack(pool, thisCellW, thisCellH, rects, allUsed);
+            float occupancy = binPacker.occupancy();
+
+            // Consider the atlas resolved when after the first pass, all textures are used, and the occupancy > 0.5f, scaling
+            // down by half to maintain PO2 requirements means this is as good as it gets
+            bool firstPassFull = numPasses == 1 && occupancy > 0.5f;
+
+            // Reverted copes with the case when halving the atlas size when occupancy < 0.5f, the textures don't fit in the
+            // atlas anymore. At this point, size is reverted to the previous value, and the loop should accept this as the final value
+            if (firstPassFull ||
+                (numPasses > 1 && occupancy > 0.5f && allUsed) ||
+                reverted || !allowOptimizeSize)
+            {
+                std::vector<Entry> atlasEntries;
+                atlasEntries.reserve(binPacker.getMapped().size());
+
+                for (auto t : binPacker.getMapped())
+                {
+                    int matchedWidth = 0;
+                    int matchedHeight = 0;
+
+                    int matchedId = -1;
+                    bool flipped = false;
+                    for (int i = 0; i < (int)sourceRects.size(); ++i)
+                    {
+                        int width = cells(sourceRects[i].width);
+                        int height = cells(sourceRects[i].height);
+                        if (!usedRect[i] && width == t.width && height == t.height)
+                        {
+                            matchedId = i;
+                            matchedWidth = sourceRects[i].width;
+                            matchedHeight = sourceRects[i].height;
+                            break;
+                        }
+                    }
+
+                    // Not matched anything yet, so look for the same rects rotated
+                    if (matchedId == -1)
+                    {
+                        for (int i = 0; i < (int)sourceRects.size(); ++i)
+                        {
+                            int width = cells(sourceRects[i].width);
+                            int height = cells(sourceRects[i].height);
+                            if (!usedRect[i] && width == t.height && height == t.width)
+                            {
+                                matchedId = i;
+                                flipped = true;
+                                matchedWidth = sourceRects[i].height;
+                                matchedHeight = sourceRects[i].width;
+                                break;
+                            }
+                        }
+                    }
+
+                    // If this fails its a catastrophic error
+                    usedRect[matchedId] = true;
+                    Entry newEntry;
+                    newEntry.flipped = flipped;
+                    newEntry.x = t.x << alignShift;
+                    newEntry.y = t.y << alignShift;
+                    newEntry.w = matchedWidth;
+                    newEntry.h = matchedHeight;
+                    newEntry.index = matchedId;
+                    atlasEntries.push_back(newEntry);
+                }
+
+                Data currAtlas;
+                currAtlas.width = thisCellW << alignShift;
+                currAtlas.height = thisCellH << alignShift;
+                currAtlas.occupancy = binPacker.occupancy();
+                currAtlas.entries = std::move(atlasEntries);
+
+                atlases.push_back(std::move(currAtlas));
+
+                unplacedRects(rects, binPacker.getMapped(), unplaced);
+                rects.swap(unplaced);
+                break; // done
+            }
+            else
+            {
+                if (!allUsed)
+                {
+                    if (forceSquare)
+                    {
+                        thisCellW *= 2;
+                        thisCellH *= 2;
+                    }
+                    else
+                    {
+                        // Can only try another size when it already has been scaled down for the first time
+                        if (thisCellW < atlasWidth || thisCellH < atlasHeight)
+                        {
+                            // Tried to scale down, but the texture doesn't fit, so revert previous change, and
+                            // iterate over the data again forcing a pass even though there is wastage
+                            if (thisCellW < thisCellH) thisCellW *= 2;
+                            else thisCellH *= 2;
+                        }
+                    }
+
+                    reverted = true;
+                }
+                else
+                {
+                    if (forceSquare)
+                    {
+                        thisCellH /= 2;
+                        thisCellW /= 2;
+                    }
+                    else
+                    {
+                        // More than half the texture was unused, scale down by one of the dimensions
+                        if (thisCellW < thisCellH) thisCellH /= 2;
+                        else thisCellW /= 2;
+                    }
+                }
+
+                numPasses++;
+            }
+        }
+    }
+
+    remainingRectIndices.clear();
+    for (int i = 0; i < (int)usedRect.size(); ++i)
+    {
+        if (!usedRect[i])
+        {
+            remainingRectIndices.push_back(i);
+        }
+    }
+
+    return (int)remainingRectIndices.size();
+}
+
+const std::vector<Data> &AtlasLayout::getAtlases() const
+{
+    return atlases;
+}
+
+// Indices of the source rects that did not fit in any atlas
+const std::vector<int> &AtlasLayout::getRemainingRectIndices() const
+{
+    return remainingRectIndices;
+}
@@ -0,0 +1,85 @@
+#ifndef ATLAS_LAYOUT_HPP
+#define ATLAS_LAYOUT_HPP
+
+#include <functional>
+#include <vector>
+#include "atlas_rect.hpp"
+#include "max_rects_bin_pack.hpp"
+
+class Entry
+{
+public:
+    int             index, x, y, w, h;
+    bool            flipped;
+};
+
+class Data
+{
+public:
+    int             width, height;
+    float           occupancy;
+    std::vector<Entry> entries;
+
+    Entry findEntryWithIndex(int index)
+    {
+        for (const Entry &entry : entries)
+        {
+            if (index == entry.index)
+            {
+                return entry;
+            }
+        }
+
+        return Entry();
+    }
+};
+
+/// Lays out rects on as few atlases as allowed, halving each atlas while its rects still fit it more than half full.
+/// Rects are packed in cells of 2^alignShift pixels, each with gutter extra cells on its right and top. Entries keep
+/// the pixel size of their source rect and are counted from the bottom left of the atlas.
+/// This and the packer are free of Qt, so they can be linked into other tools and called through the C ABI.
+class AtlasLayout
+{
+public:
+    /// Packs rects into one bin of the given size in cells, and reports whether all of them fit. Packers should be
+    /// acquired from the pool, which the layout resets before every pass.
+    typedef std::function<MaxRectsBinPack &(PackerPool &pool, int width, int height, const std::vector<RectSize> &rects,
+                                            bool &allUsed)> PackFunction;
+
+    AtlasLayout(int atlasWidth, int atlasHeight, int maxAtlasCount, bool allowOptimizeSize, bool forceSquare, bool allowRotation);
+    void setOptions(int atlasWidth, int atlasHeight, int maxAtlasCount, bool allowOptimizeSize, bool forceSquare, bool allowRotation);
+    void setAlignment(int alignShift, int gutter);
+    int build(const std::vector<RectSize> &sourceRects);
+    int build(const std::vector<RectSize> &sourceRects, const PackFunction &pack);
+    const std::vector<Data> &getAtlases() const;
+    const std::vector<int> &getRemainingRectIndices() const;
+
+    static MaxRectsBinPack &packBestHeuristic(PackerPool &pool, int width, int height, const std::vector<RectSize> &rects,
+                                              bool allowRotation, bool &allUsed, long long *heuristicMicroseconds = nullptr);
+    static void unplacedRects(const std::vector<RectSize> &rects, const std::vector<Rect> &placed, std::vector<RectSize> &remaining);
+
+    static const int heuristicCount = 5;
+    static const FreeRectChoiceHeuristic heuristics[heuristicCount];
+    static const char *const heuristicNames[heuristicCount];
+
+private:
+    int cells(int pixels) const;
+
+    int             atlasWidth = 0;
+    int             atlasHeight = 0;
+    int             maxAtlasCount = 0;
+    bool            allowOptimizeSize = true;
+    bool            forceSquare = false;
+    bool            allowRotation = true;
+    int             alignShift = 0;
+    int             gutter = 0;
+
+    std::vector<Data> atlases;
+    std::vector<int> remainingRectIndices;
+
+    // Reused by every pass of every build
+    PackerPool      pool;
+    std::vector<RectSize> unplaced;
+};
+
+#endif // ATLAS_LAYOUT_HPP
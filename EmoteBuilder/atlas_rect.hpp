@@ -1,8 +1,6 @@
 #ifndef ATLAS_RECT_HPP
 #define ATLAS_RECT_HPP
 
-#include <QObject>
-
 class RectSize
 {
 public:
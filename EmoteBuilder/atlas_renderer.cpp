@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cstring>
+#include "atlas_renderer.hpp"
+#include "sparse_frame.hpp"
+
+// Makes the whole buffer transparent, in one fill when its rows are contiguous
+void AtlasRenderer::clear(uint32_t *pixels, int width, int height, ptrdiff_t stride)
+{
+    if (stride == width)
+    {
+        std::memset(pixels, 0, (size_t)width * height * sizeof(uint32_t));
+        return;
+    }
+
+    for (int y = 0; y < height; ++y)
+        std::memset(pixels + y * stride, 0, (size_t)width * sizeof(uint32_t));
+}
+
+/// Copies one frame to the atlas region of its entry. Upright frames are copied a row at a time, flipped frames are
+/// turned so that source row y lands in column w - 1 - y of the entry and source column x in its row x.
+void AtlasRenderer::blit(const Entry &entry, int atlasHeight, const FramePixels &frame, uint32_t *pixels, ptrdiff_t stride)
+{
+    blitRows(entry, atlasHeight, frame, 0, atlasHeight, pixels, stride);
+}
+
+/// Copies the part of a frame that falls into a band of atlas rows, counted from the top. Pixels points to the first
+/// row of the band, so a band can be rendered without the rest of the atlas.
+void AtlasRenderer::blitRows(const Entry &entry, int atlasHeight, const FramePixels &frame, int firstRow, int rowCount,
+                             uint32_t *pixels, ptrdiff_t stride)
+{
+    int entryTop = atlasHeight - entry.h - entry.y;
+    int frameRows = entry.flipped ? frame.width : frame.height;
+    int begin = std::max(firstRow, entryTop) - entryTop;
+    int end = std::min(firstRow + rowCount, entryTop + frameRows) - entryTop;
+    if (begin >= end)
+        return;
+
+    // The first entry row inside the band
+    uint32_t *top = pixels + (ptrdiff_t)(entryTop + begin - firstRow) * stride + entry.x;
+
+    if (!entry.flipped)
+    {
+        for (int y = begin; y < end; ++y)
+            std::memcpy(top + (y - begin) * stride, frame.pixels + y * frame.stride, (size_t)frame.width * sizeof(uint32_t));
+    }
+    else
+    {
+        // Walk the source a row at a time so reads stay sequential, writes go down one atlas column. Atlas rows are
+        // source columns here, so the band limits the columns read.
+        for (int y = 0; y < frame.height; ++y)
+        {
+            const uint32_t *sourceLine = frame.pixels + (frame.height - y - 1) * frame.stride;
+            uint32_t *column = top + y;
+            for (int x = begin; x < end; ++x)
+                column[(x - begin) * stride] = sourceLine[x];
+        }
+    }
+}
+
+// Draws only the visible pixels of a sparse frame, over an atlas cleared beforehand
+void AtlasRenderer::blit(const Entry &entry, int atlasHeight, const SparseFrame &frame, uint32_t *pixels, ptrdiff_t stride)
+{
+    blitRows(entry, atlasHeight, frame, 0, atlasHeight, pixels, stride);
+}
+
+/// Draws the visible pixels of a sparse frame that fall into a band of atlas rows, turned like the dense blit for
+/// flipped entries.
+void AtlasRenderer::blitRows(const Entry &entry, int atlasHeight, const SparseFrame &frame, int firstRow, int rowCount,
+                             uint32_t *pixels, ptrdiff_t stride)
+{
+    int entryTop = atlasHeight - entry.h - entry.y;
+    int frameRows = entry.flipped ? frame.width : frame.height;
+    int begin = std::max(firstRow, entryTop) - entryTop;
+    int end = std::min(firstRow + rowCount, entryTop + frameRows) - entryTop;
+    if (begin >= end)
+        return;
+
+    uint32_t *top = pixels + (ptrdiff_t)(entryTop + begin - firstRow) * stride + entry.x;
+
+    if (!entry.flipped)
+    {
+        for (int y = begin; y < end; ++y)
+        {
+            uint32_t *line = top + (y - begin) * stride;
+            for (int s = frame.rowSpans[y]; s < frame.rowSpans[y + 1]; ++s)
+            {
+                const PixelSpan &span = frame.spans[s];
+                std::memcpy(line + span.x, frame.pixels.data() + span.pixelIndex, (size_t)span.length * sizeof(uint32_t));
+            }
+        }
+    }
+    else
+    {
+        // Source row y lands in entry column h - 1 - y, source columns are atlas rows clipped to the band
+        for (int y = 0; y < frame.height; ++y)
+        {
+            uint32_t *column = top + (frame.height - y - 1);
+            for (int s = frame.rowSpans[y]; s < frame.rowSpans[y + 1]; ++s)
+            {
+                const PixelSpan &span = frame.spans[s];
+                int spanBegin = std::max(begin, span.x);
+                int spanEnd = std::min(end, span.x + span.length);
+                const uint32_t *source = frame.pixels.data() + span.pixelIndex - span.x;
+                for (int x = spanBegin; x < spanEnd; ++x)
+                    column[(x - begin) * stride] = source[x];
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef ATLAS_RENDERER_HPP
+#define ATLAS_RENDERER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "atlas_layout.hpp"
+
+class SparseFrame;
+
+/// A 32-bit pixel buffer that is only read. Stride is in pixels, and may be negative for buffers stored bottom up.
+class FramePixels
+{
+public:
+    const uint32_t *pixels;
+    int             width, height;
+    ptrdiff_t       stride;
+};
+
+/// Draws the frames of an atlas layout into a caller provided 32-bit buffer. Pixels are copied, so any channel order
+/// works as long as frames and atlas agree. Rows are addressed top down from the pixels pointer, entries count y from
+/// the bottom of the atlas.
+class AtlasRenderer
+{
+public:
+    static void clear(uint32_t *pixels, int width, int height, ptrdiff_t stride);
+    static void blit(const Entry &entry, int atlasHeight, const FramePixels &frame, uint32_t *pixels, ptrdiff_t stride);
+    static void blitRows(const Entry &entry, int atlasHeight, const FramePixels &frame, int firstRow, int rowCount,
+                         uint32_t *pixels, ptrdiff_t stride);
+    static void blit(const Entry &entry, int atlasHeight, const SparseFrame &frame, uint32_t *pixels, ptrdiff_t stride);
+    static void blitRows(const Entry &entry, int atlasHeight, const SparseFrame &frame, int firstRow, int rowCount,
+                         uint32_t *pixels, ptrdiff_t stride);
+};
+
+#endif // ATLAS_RENDERER_HPP
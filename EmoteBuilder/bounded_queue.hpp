@@ -0,0 +1,71 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QWaitCondition>
+
+/// A blocking FIFO with a fixed capacity that connects two pipeline stages. Producers wait while it is full,
+/// so the capacity caps how many items are in flight between the stages, and consumers wait while it is empty
+/// until the producing side closes it.
+template <class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity)
+    {
+        this->capacity = std::max(1, capacity);
+    }
+
+    /// Blocks while the queue is full.
+    /// @return False if the queue was closed, in which case the item is dropped.
+    bool push(const T &item)
+    {
+        QMutexLocker locker(&mutex);
+        while (items.count() >= capacity && !closed)
+            notFull.wait(&mutex);
+
+        if (closed)
+            return false;
+
+        items.enqueue(item);
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    /// Blocks until an item is available.
+    /// @return False once the queue is closed and every item has been taken.
+    bool pop(T &item)
+    {
+        QMutexLocker locker(&mutex);
+        while (items.isEmpty() && !closed)
+            notEmpty.wait(&mutex);
+
+        if (items.isEmpty())
+            return false;
+
+        item = items.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    /// Marks the end of the stream, consumers still receive the items already queued.
+    void close()
+    {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+private:
+    QMutex          mutex;
+    QWaitCondition  notEmpty;
+    QWaitCondition  notFull;
+    QQueue<T>       items;
+    int             capacity = 1;
+    bool            closed = false;
+};
+
+#endif // BOUNDED_QUEUE_HPP
@@ -0,0 +1,75 @@
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "build_scheduler.hpp"
+
+BuildScheduler::BuildScheduler(int workerCount)
+{
+    workers = std::max(1, workerCount);
+}
+
+int BuildScheduler::workerCount() const
+{
+    return workers;
+}
+
+// Tasks taken from another worker's queue during the last run
+int BuildScheduler::stealCount() const
+{
+    return steals.loadRelaxed();
+}
+
+/// Takes the next task of a worker, its own oldest one or else the newest one of the first other queue that has any.
+/// Tasks never add tasks, so once every queue is empty the worker is done.
+bool BuildScheduler::take(int worker, BuildTask &task)
+{
+    for (int i = 0; i < workers; ++i)
+    {
+        WorkerQueue &queue = *queues[(worker + i) % workers];
+        QMutexLocker locker(&queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+
+        if (i == 0)
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        else
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            steals.fetchAndAddRelaxed(1);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/// Runs every task and returns once all have finished. The workers get a pool of their own, since the builds use the
+/// global pool for their own parallel stages and would otherwise wait on threads taken by other builds.
+void BuildScheduler::run(const QList<BuildTask> &tasks)
+{
+    queues.clear();
+    for (int i = 0; i < workers; ++i)
+        queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    for (int i = 0; i < tasks.count(); ++i)
+        queues[i % workers]->tasks.push_back(tasks[i]);
+    steals.storeRelaxed(0);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workers);
+    QList<QFuture<void>> running;
+    for (int worker = 0; worker < workers; ++worker)
+    {
+        running.append(QtConcurrent::run(&pool, [this, worker]()
+        {
+            BuildTask task;
+            while (take(worker, task))
+                task();
+        }));
+    }
+
+    for (QFuture<void> &future : running)
+        future.waitForFinished();
+}
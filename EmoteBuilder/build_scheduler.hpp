@@ -0,0 +1,42 @@
+#ifndef BUILD_SCHEDULER_HPP
+#define BUILD_SCHEDULER_HPP
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+
+typedef std::function<void()> BuildTask;
+
+// The tasks dealt to one worker, guarded since other workers steal from it
+class WorkerQueue
+{
+public:
+    QMutex          mutex;
+    std::deque<BuildTask> tasks;
+};
+
+/// Runs independent build tasks on a fixed number of worker threads. Tasks are dealt round robin in the given order,
+/// so callers put the largest first. Every worker runs its own tasks from the front and, once they run out, steals
+/// from the back of the other queues, so a worker that drew short builds takes over the small tasks still waiting
+/// behind a long one. Tasks must not share state, they run in no particular order.
+class BuildScheduler
+{
+public:
+    explicit BuildScheduler(int workerCount);
+    void run(const QList<BuildTask> &tasks);
+    int workerCount() const;
+    int stealCount() const;
+
+private:
+    bool take(int worker, BuildTask &task);
+
+    int             workers = 1;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    QAtomicInt      steals;
+};
+
+#endif // BUILD_SCHEDULER_HPP
@@ -1,16 +1,35 @@
-﻿#include <QDir>
+﻿#include <QBuffer>
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QImage>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSet>
 #include <QStandardPaths>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "allocation_tracker.hpp"
+#include "atlas_renderer.hpp"
 #include "builder.hpp"
-#include "emote_builder.hpp"
+#include "exact_packer.hpp"
+#include "frame_splitter.hpp"
+#include "lod_filter.hpp"
 #include "logger.hpp"
-#include "max_rects_bin_pack.hpp"
+#include "memory_usage.hpp"
+#include "pack_optimizer.hpp"
+#include "palette_quantizer.hpp"
+#include "png_stream_writer.hpp"
+#include "similarity_placement.hpp"
+#include "sprite_definition.hpp"
+#include "sprite_mesh.hpp"
+#include "tile_dedup.hpp"
 
-Builder::Builder(int atlasWidth, int atlasHeight, int maxAllowedAtlasCount, bool allowOptimizeSize, bool forceSquare, bool allowRotation, QObject* parent) : QObject(parent)
+Builder::Builder(int atlasWidth, int atlasHeight, int maxAllowedAtlasCount, bool allowOptimizeSize, bool forceSquare, bool allowRotation, QObject* parent)
+    : QObject(parent)
+    , layout(atlasWidth, atlasHeight, maxAllowedAtlasCount, allowOptimizeSize, forceSquare, allowRotation)
+    , optimizer(0, 0, allowRotation)
 {
     this->atlasWidth = atlasWidth;
     this->atlasHeight = atlasHeight;
@@ -26,333 +45,1160 @@ void Builder::addRect(int width, int height)
     RectSize rs;
     rs.width = width;
     rs.height = height;
-    sourceRects.append(rs);
+    sourceRects.push_back(rs);
 }
 
-MaxRectsBinPack Builder::findBestBinPacker(int width, int height, QList<RectSize> &currRects, bool &allUsed)
+MaxRectsBinPack &Builder::findBestBinPacker(PackerPool &pool, int width, int height, const std::vector<RectSize> &currRects, bool &allUsed)
 {
-    QList<MaxRectsBinPack> binPackers;
-    QList<QList<RectSize>> binPackerRects;
-    QList<bool> binPackerAllUsed;
+    AllocationScope heuristicScope("pack: heuristics");
+    long long heuristicMicroseconds[AtlasLayout::heuristicCount];
+    MaxRectsBinPack &bestBinPacker = AtlasLayout::packBestHeuristic(pool, width, height, currRects, allowRotation, allUsed,
+                                                                    heuristicMicroseconds);
+    oversizeTextures = true;
 
-    //MaxRectsBinPack.FreeRectChoiceHeuristic[] heuristics = { MaxRectsBinPack.FreeRectChoiceHeuristic.RectBestAreaFit,
-    //                                                         MaxRectsBinPack.FreeRectChoiceHeuristic.RectBestLongSideFit,
-    //                                                         MaxRectsBinPack.FreeRectChoiceHeuristic.RectBestShortSideFit,
-    //                                                         MaxRectsBinPack.FreeRectChoiceHeuristic.RectBottomLeftRule,
-    //                                                         MaxRectsBinPack.FreeRectChoiceHeuristic.RectContactPointRule };
+    QStringList timings;
+    for (int i = 0; i < AtlasLayout::heuristicCount; ++i)
+        timings.append(QString("%1 %2 ms").arg(AtlasLayout::heuristicNames[i]).arg(heuristicMicroseconds[i] / 1000));
+    buildLog.write(QString("Packed %1 rects into %2x%3: %4").arg(currRects.size()).arg(width).arg(height).arg(timings.join(", ")));
 
-    FreeRectChoiceHeuristic heuristics[4] = { RectBestAreaFit,
-                                              RectBestLongSideFit,
-                                              RectBestShortSideFit,
-                                              RectBottomLeftRule,
-                                            };
-
-    for (auto heuristic : heuristics)
+    // Multi-start search over input orderings, only kept when it beats the greedy heuristics
+    MaxRectsBinPack *binPacker = &bestBinPacker;
+    if (optimizeTimeBudget > 0)
     {
-        MaxRectsBinPack binPacker(width, height, allowRotation);
-        QList<RectSize> activeRects(currRects);
-        bool activeAllUsed = binPacker.insert(activeRects, heuristic);
-
-        binPackers.append(binPacker);
-        binPackerRects.append(activeRects);
-        binPackerAllUsed.append(activeAllUsed);
+        AllocationScope allocationScope("pack: optimizer");
+        QElapsedTimer timer;
+        timer.start();
+        MaxRectsBinPack &optimizedBinPacker = pool.acquire(width, height, allowRotation);
+        bool optimizedAllUsed = optimizer.optimize(width, height, currRects, optimizedBinPacker);
+        buildLog.write(QString("Packing optimizer ran %1 trials in %2 ms, best occupancy %3")
+                       .arg(optimizer.trialCount())
+                       .arg(timer.elapsed())
+                       .arg(optimizedBinPacker.occupancy()));
+        if ((optimizedAllUsed && !allUsed) ||
+            (optimizedAllUsed == allUsed && optimizedBinPacker.wastedBinArea() < binPacker->wastedBinArea()))
+        {
+            allUsed = optimizedAllUsed;
+            binPacker = &optimizedBinPacker;
+        }
     }
 
-    int leastWastedPixels = std::numeric_limits<int>::max();
-    int leastWastedIndex = -1;
-    for (int i = 0; i < binPackers.count(); ++i)
+    // Small sets the heuristics could not fit are decided exactly, which lets the size search go down to the smallest
+    // atlas that holds them. When the search runs out of time the heuristic result stands.
+    if (!allUsed && exactTimeLimit > 0 && (int)currRects.size() <= ExactPacker::maxRectCount)
     {
-        int wastedPixels = binPackers[i].wastedBinArea();
-        if (wastedPixels < leastWastedPixels)
+        AllocationScope allocationScope("pack: exact");
+        QElapsedTimer timer;
+        timer.start();
+
+        MaxRectsBinPack &exactBinPacker = pool.acquire(width, height, allowRotation);
+        ExactPacker exactPacker(allowRotation, exactTimeLimit);
+        ExactResult result = exactPacker.pack(width, height, currRects, exactBinPacker);
+
+        static const char *resultNames[] = { "packed", "proven not to fit", "timed out" };
+        buildLog.write(QString("Exact search for %1 rects in %2x%3 %4 after %5 nodes in %6 ms")
+                       .arg(currRects.size()).arg(width).arg(height).arg(resultNames[result])
+                       .arg(exactPacker.nodeCount()).arg(timer.elapsed()));
+
+        if (result == ExactPacked)
         {
-            leastWastedPixels = wastedPixels;
-            leastWastedIndex = i;
-            oversizeTextures = true;
+            allUsed = true;
+            binPacker = &exactBinPacker;
         }
     }
 
-    currRects = binPackerRects[leastWastedIndex];
-    allUsed = binPackerAllUsed[leastWastedIndex];
-    return binPackers[leastWastedIndex];
+    return *binPacker;
 }
 
+// Lays out the source rects with the packing library, picking the best heuristic per atlas and optionally optimizing
 int Builder::build()
 {
-    atlases.clear();
-    remainingRectIndices.clear();
-    QList<bool> usedRect(sourceRects.count());
+    AllocationScope allocationScope("pack: layout");
+
+    // The layout is kept between builds so that its packers are reused instead of allocated again
+    layout.setOptions(atlasWidth, atlasHeight, maxAllowedAtlasCount, allowOptimizeSize, forceSquare, allowRotation);
+
+    // With detail levels, one more cell on the right and top keeps a transparent gutter between sprites that is still
+    // a texel wide at the smallest level
+    layout.setAlignment(alignShift, lodLevels > 0 ? 1 : 0);
+    layout.build(sourceRects, [this](PackerPool &pool, int width, int height, const std::vector<RectSize> &rects,
+                                     bool &allUsed) -> MaxRectsBinPack &
+    {
+        return findBestBinPacker(pool, width, height, rects, allUsed);
+    });
+
+    atlases = layout.getAtlases();
+    remainingRectIndices = layout.getRemainingRectIndices();
+    return (int)remainingRectIndices.size();
+}
+
+inline void swap(QJsonValueRef valueA, QJsonValueRef valueB)
+{
+    QJsonValue temp(valueA);
+    valueA = QJsonValue(valueB);
+    valueB = temp;
+}
+
+// Traces a mesh for every frame, one at a time so spilled frames are mapped only briefly
+void Builder::buildMeshes()
+{
+    AllocationScope allocationScope("render: meshes");
+    QElapsedTimer timer;
+    timer.start();
+
+    double meshArea = 0, quadArea = 0;
+    int vertexCount = 0;
+    for (int id = 0; id < frames->count(); ++id)
+    {
+        meshes.append(MeshBuilder::build(frames->image(id), meshVertexBudget));
+        QSize size = frames->size(id);
+        meshArea += meshes.last().area;
+        quadArea += (double)size.width() * size.height();
+        vertexCount += meshes.last().vertices.count();
+    }
+
+    buildLog.write(QString("Built %1 sprite meshes in %2 ms, %3 vertices on average, covering %4% of the quad area")
+                   .arg(meshes.count())
+                   .arg(timer.elapsed())
+                   .arg(meshes.isEmpty() ? 0.0 : (double)vertexCount / meshes.count())
+                   .arg(quadArea > 0 ? 100.0 * meshArea / quadArea : 0.0));
+}
+
+// Discards what is written to it and counts the bytes, to measure an encoding without keeping it
+class ByteCounter : public QIODevice
+{
+public:
+    qint64          count = 0;
+
+protected:
+    qint64 readData(char *, qint64) override
+    {
+        return -1;
+    }
 
-    int atlasWidth = this->atlasWidth >> alignShift;
-    int atlasHeight = this->atlasHeight >> alignShift;
+    qint64 writeData(const char *, qint64 size) override
+    {
+        count += size;
+        return size;
+    }
+};
 
-    // Sanity check, can't build with textures larger than the actual max atlas size
-    int align = (1 << alignShift) - 1;
-    int minSize = std::max(atlasWidth, atlasHeight);
-    int maxSize = std::max(atlasWidth, atlasHeight);
-    for (RectSize rs : sourceRects)
+/// Bytes of the full-size page exactly as saveAtlas or streamAtlas write it. Streamed pages are streamed into a counter,
+/// so measuring them holds no more of the page in memory than writing it does.
+qint64 Builder::encodedSize(const Data &atlas)
+{
+    if (streamsAtlases())
     {
-        int maxDim = (std::max(rs.width, rs.height) + align) >> alignShift;
-        int minDim = (std::max(rs.width, rs.height) + align) >> alignShift;
+        ByteCounter counter;
+        counter.open(QIODevice::WriteOnly);
+        PngStreamWriter writer;
+        writer.setCompressed(compressesAtlases());
+        writer.open(&counter, atlas.width, atlas.height);
+        writeBands(atlas, writer);
+        writer.close();
+        return counter.count;
+    }
+
+    QImage tex = renderAtlas(atlas);
+    if (paletteSize > 0)
+        tex = PaletteQuantizer(paletteSize, ditherPalette).quantize(tex);
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    tex.save(&buffer, "PNG", pngQuality());
+    return buffer.size();
+}
+
+/// Moves similar frames next to each other within slots of equal size. Each atlas is encoded before and after, and
+/// keeps the arrangement only if it is written smaller. Encoding every page twice more costs time, but streamed pages
+/// stay within the memory of streaming.
+void Builder::arrangeBySimilarity()
+{
+    AllocationScope allocationScope("pack: similarity placement");
+    QElapsedTimer timer;
+    timer.start();
 
-        // largest texture needs to fit in an atlas
-        if (maxDim > maxSize || (maxDim <= maxSize && minDim > minSize))
+    // Stored PNG data is as large in any order
+    if (streamsAtlases() && !PngStreamWriter::canCompress())
+    {
+        buildLog.write("Similarity placement skipped, streamed atlases are written uncompressed in builds without zlib");
+        return;
+    }
+
+    qint64 bytesBefore = 0, bytesAfter = 0;
+    int moved = 0;
+    for (Data &atlas : atlases)
+    {
+        Data original = atlas;
+        int atlasMoved = SimilarityPlacement::arrange(atlas, *frames);
+        qint64 before = encodedSize(original);
+        qint64 after = atlasMoved > 0 ? encodedSize(atlas) : before;
+        if (after >= before)
         {
-            remainingRectIndices.clear();
-            for (int i = 0; i < sourceRects.count(); ++i)
-                remainingRectIndices.append(i);
-            return remainingRectIndices.count();
+            atlas = original;
+            after = before;
+            atlasMoved = 0;
         }
+
+        bytesBefore += before;
+        bytesAfter += after;
+        moved += atlasMoved;
     }
 
-    // Start with all source rects, this list will get reduced over time
-    QList<RectSize> rects;
-    for (RectSize rs : sourceRects)
+    buildLog.write(QString("Similarity placement moved %1 frames in %2 ms, atlas PNGs %3 -> %4 bytes (%5% smaller)")
+                   .arg(moved)
+                   .arg(timer.elapsed())
+                   .arg(bytesBefore)
+                   .arg(bytesAfter)
+                   .arg(bytesBefore > 0 ? 100.0 * (bytesBefore - bytesAfter) / bytesBefore : 0.0, 0, 'f', 1));
+}
+
+static qint64 atlasArea(const std::vector<Data> &atlases)
+{
+    qint64 area = 0;
+    for (const Data &atlas : atlases)
+        area += (qint64)atlas.width * atlas.height;
+    return area;
+}
+
+/// Cuts frames with large transparent parts into pieces and lays out the pieces instead of the frames. The split
+/// layout replaces the one already built only if it leaves no more frames out and takes less atlas area.
+void Builder::splitFrames()
+{
+    AllocationScope allocationScope("pack: frame splitting");
+    QElapsedTimer timer;
+    timer.start();
+
+    FrameSplitter splitter(maxSplitPieces);
+    std::vector<FramePiece> framePieces;
+    int splitCount = 0;
+    qint64 frameArea = 0, pieceArea = 0;
+    for (int id = 0; id < frames->count(); ++id)
     {
-        RectSize t;
-        t.width = (rs.width + align) >> alignShift;
-        t.height = (rs.height + align) >> alignShift;
-        rects.append(t);
+        QImage image = frames->image(id);
+        if (image.format() != QImage::Format_ARGB32)
+            image = image.convertToFormat(QImage::Format_ARGB32);
+
+        FramePixels pixels;
+        pixels.pixels = reinterpret_cast<const uint32_t *>(image.constBits());
+        pixels.width = image.width();
+        pixels.height = image.height();
+        pixels.stride = image.bytesPerLine() / (int)sizeof(uint32_t);
+        if (splitter.split(id, pixels, framePieces) > 1)
+            splitCount++;
+        frameArea += (qint64)image.width() * image.height();
     }
+    for (const FramePiece &piece : framePieces)
+        pieceArea += (qint64)piece.width * piece.height;
 
-    bool allUsed = false;
-    while (allUsed == false && atlases.count() < maxAllowedAtlasCount)
+    if (splitCount == 0)
     {
-        int numPasses = 1;
-        int thisCellW = atlasWidth, thisCellH = atlasHeight;
-        bool reverted = false;
+        buildLog.write("No frame saves enough area to be split, packing whole frames");
+        return;
+    }
+
+    std::vector<RectSize> frameRects = sourceRects;
+    std::vector<Data> frameAtlases = atlases;
+    std::vector<int> frameRemaining = remainingRectIndices;
 
-        while (numPasses > 0)
+    sourceRects.clear();
+    for (const FramePiece &piece : framePieces)
+        addRect(piece.width, piece.height);
+    build();
+
+    // A frame is left out when any of its pieces is
+    QSet<int> missingFrames;
+    for (int index : remainingRectIndices)
+        missingFrames.insert(framePieces[index].frame);
+
+    qint64 wholeArea = atlasArea(frameAtlases);
+    qint64 splitArea = atlasArea(atlases);
+    bool better = missingFrames.count() < (int)frameRemaining.size() ||
+                  (missingFrames.count() == (int)frameRemaining.size() && splitArea < wholeArea);
+    buildLog.write(QString("Split %1 of %2 frames into %3 pieces in %4 ms, sprite area %5 -> %6 px, atlas area %7 -> %8 px (%9%)%10")
+                   .arg(splitCount)
+                   .arg(frames->count())
+                   .arg(framePieces.size())
+                   .arg(timer.elapsed())
+                   .arg(frameArea)
+                   .arg(pieceArea)
+                   .arg(wholeArea)
+                   .arg(splitArea)
+                   .arg(wholeArea > 0 ? 100.0 * (splitArea - wholeArea) / wholeArea : 0.0, 0, 'f', 1)
+                   .arg(better ? "" : ", keeping whole frames"));
+
+    if (!better)
+    {
+        sourceRects = frameRects;
+        atlases = frameAtlases;
+        remainingRectIndices = frameRemaining;
+        return;
+    }
+
+    pieces = framePieces;
+    if (!missingFrames.isEmpty())
+        buildLog.write(QString("%1 split frames did not fit in %2 atlases").arg(missingFrames.count()).arg(maxAllowedAtlasCount));
+}
+
+/// The pixels an entry shows, the region of its piece for split frames.
+/// @param source [out] Holds the frame image the pixels point into, keep it alive while they are used.
+FramePixels Builder::entryPixels(const Entry &entry, QImage &source) const
+{
+    const FramePiece *piece = pieces.empty() ? nullptr : &pieces[entry.index];
+    source = frames->image(piece ? piece->frame : entry.index);
+    if (source.format() != QImage::Format_ARGB32)
+        source = source.convertToFormat(QImage::Format_ARGB32);
+
+    FramePixels frame;
+    frame.pixels = reinterpret_cast<const uint32_t *>(source.constBits());
+    frame.width = source.width();
+    frame.height = source.height();
+    frame.stride = source.bytesPerLine() / (int)sizeof(uint32_t);
+    if (piece)
+    {
+        frame.pixels += piece->y * frame.stride + piece->x;
+        frame.width = piece->width;
+        frame.height = piece->height;
+    }
+    return frame;
+}
+
+// Draws the frames of one atlas into a transparent texture, rows counted from the bottom as in the entries
+QImage Builder::renderAtlas(const Data &atlas)
+{
+    AllocationScope allocationScope("render: atlas pages");
+    QImage tex(atlas.width, atlas.height, QImage::Format_ARGB32);
+    uint32_t *pixels = reinterpret_cast<uint32_t *>(tex.bits());
+    ptrdiff_t stride = tex.bytesPerLine() / (int)sizeof(uint32_t);
+    AtlasRenderer::clear(pixels, tex.width(), tex.height(), stride);
+
+    for (const Entry &entry : atlas.entries)
+    {
+        // Mostly transparent frames only draw their visible spans over the cleared texture
+        QSharedPointer<const SparseFrame> sparse = pieces.empty() ? frames->sparseFrame(entry.index) : nullptr;
+        if (sparse)
         {
-            // Create copy to make sure we can scale textures down when necessary
-            QList<RectSize> currRects(rects);
-
-//					MaxRectsBinPack binPacker = new MaxRectsBinPack(thisCellW, thisCellH);
-//					allUsed = binPacker.Insert(currRects, MaxRectsBinPack.FreeRectChoiceHeuristic.RectBestAreaFit);
-            MaxRectsBinPack binPacker = findBestBinPacker(thisCellW, thisCellH, currRects, allUsed);
-            float occupancy = binPacker.occupancy();
-
-            // Consider the atlas resolved when after the first pass, all textures are used, and the occupancy > 0.5f, scaling
-            // down by half to maintain PO2 requirements means this is as good as it gets
-            bool firstPassFull = numPasses == 1 && occupancy > 0.5f;
-
-            // Reverted copes with the case when halving the atlas size when occupancy < 0.5f, the textures don't fit in the
-            // atlas anymore. At this point, size is reverted to the previous value, and the loop should accept this as the final value
-            if (firstPassFull ||
-                (numPasses > 1 && occupancy > 0.5f && allUsed) ||
-                reverted || !allowOptimizeSize)
-            {
-                QList<Entry> atlasEntries;
+            AtlasRenderer::blit(entry, tex.height(), *sparse, pixels, stride);
+            continue;
+        }
 
-                for (auto t : binPacker.getMapped())
-                {
-                    int matchedWidth = 0;
-                    int matchedHeight = 0;
-
-                    int matchedId = -1;
-                    bool flipped = false;
-                    for (int i = 0; i < sourceRects.count(); ++i)
-                    {
-                        int width = (sourceRects[i].width + align) >> alignShift;
-                        int height = (sourceRects[i].height + align) >> alignShift;
-                        if (!usedRect[i] && width == t.width && height == t.height)
-                        {
-                            matchedId = i;
-                            matchedWidth = sourceRects[i].width;
-                            matchedHeight = sourceRects[i].height;
-                            break;
-                        }
-                    }
-
-                    // Not matched anything yet, so look for the same rects rotated
-                    if (matchedId == -1)
-                    {
-                        for (int i = 0; i < sourceRects.count(); ++i)
-                        {
-                            int width = (sourceRects[i].width + align) >> alignShift;
-                            int height = (sourceRects[i].height + align) >> alignShift;
-                            if (!usedRect[i] && width == t.height && height == t.width)
-                            {
-                                matchedId = i;
-                                flipped = true;
-                                matchedWidth = sourceRects[i].height;
-                                matchedHeight = sourceRects[i].width;
-                                break;
-                            }
-                        }
-                    }
-
-                    // If this fails its a catastrophic error
-                    usedRect[matchedId] = true;
-                    Entry newEntry;
-                    newEntry.flipped = flipped;
-                    newEntry.x = t.x << alignShift;
-                    newEntry.y = t.y << alignShift;
-                    newEntry.w = matchedWidth;
-                    newEntry.h = matchedHeight;
-                    newEntry.index = matchedId;
-                    atlasEntries.append(newEntry);
-                }
+        QImage source;
+        AtlasRenderer::blit(entry, tex.height(), entryPixels(entry, source), pixels, stride);
+    }
 
-                Data currAtlas;
-                currAtlas.width = thisCellW << alignShift;
-                currAtlas.height = thisCellH << alignShift;
-                currAtlas.occupancy = binPacker.occupancy();
-                currAtlas.entries = atlasEntries;
+    return tex;
+}
 
-                atlases.append(currAtlas);
+// Detail levels and palettes are computed from the whole page, without them pages are streamed in bands
+bool Builder::streamsAtlases() const
+{
+    return lodLevels == 0 && paletteSize == 0;
+}
 
-                rects = currRects;
-                break; // done
-            }
-            else
-            {
-                if (!allUsed)
-                {
-                    if (forceSquare)
-                    {
-                        thisCellW *= 2;
-                        thisCellH *= 2;
-                    }
-                    else
-                    {
-                        // Can only try another size when it already has been scaled down for the first time
-                        if (thisCellW < atlasWidth || thisCellH < atlasHeight)
-                        {
-                            // Tried to scale down, but the texture doesn't fit, so revert previous change, and
-                            // iterate over the data again forcing a pass even though there is wastage
-                            if (thisCellW < thisCellH) thisCellW *= 2;
-                            else thisCellH *= 2;
-                        }
-                    }
-
-                    reverted = true;
-                }
-                else
-                {
-                    if (forceSquare)
-                    {
-                        thisCellH /= 2;
-                        thisCellW /= 2;
-                    }
-                    else
-                    {
-                        // More than half the texture was unused, scale down by one of the dimensions
-                        if (thisCellW < thisCellH) thisCellH /= 2;
-                        else thisCellW /= 2;
-                    }
-                }
+// Atlases are stored uncompressed, which writes fastest, unless similarity placement is on, whose gain only shows
+// once compressed
+bool Builder::compressesAtlases() const
+{
+    return similarityPlacement;
+}
 
-                numPasses++;
-            }
+// Quality for Qt's PNG writer, 100 stores the image data and -1 compresses at the default level
+int Builder::pngQuality() const
+{
+    return compressesAtlases() ? -1 : 100;
+}
+
+/// Composites the rows of one band of an atlas, drawing only the entries that overlap it.
+void Builder::renderBand(const Data &atlas, const std::vector<int> &entryIndices, AtlasBand &band) const
+{
+    AllocationScope allocationScope("render: bands");
+    band.pixels.resize((size_t)atlas.width * band.rowCount);
+    AtlasRenderer::clear(band.pixels.data(), atlas.width, band.rowCount, atlas.width);
+
+    for (int entryIndex : entryIndices)
+    {
+        const Entry &entry = atlas.entries[entryIndex];
+        QSharedPointer<const SparseFrame> sparse = pieces.empty() ? frames->sparseFrame(entry.index) : nullptr;
+        if (sparse)
+        {
+            AtlasRenderer::blitRows(entry, atlas.height, *sparse, band.firstRow, band.rowCount, band.pixels.data(), atlas.width);
+            continue;
         }
+
+        QImage source;
+        AtlasRenderer::blitRows(entry, atlas.height, entryPixels(entry, source), band.firstRow, band.rowCount,
+                                band.pixels.data(), atlas.width);
+    }
+}
+
+/// Renders an atlas in bands of rows on the thread pool and writes them to an open writer, so memory is bounded by
+/// two batches of bands instead of the whole page. One batch renders while the previous one is written.
+void Builder::writeBands(const Data &atlas, PngStreamWriter &writer)
+{
+    // Entries overlapping each band, found once rather than testing every entry per band
+    int bandCount = (atlas.height + bandRows - 1) / bandRows;
+    std::vector<std::vector<int>> bandEntries(bandCount);
+    for (int i = 0; i < (int)atlas.entries.size(); ++i)
+    {
+        const Entry &entry = atlas.entries[i];
+        int top = atlas.height - entry.h - entry.y;
+        for (int band = std::max(0, top / bandRows); band <= (top + entry.h - 1) / bandRows && band < bandCount; ++band)
+            bandEntries[band].push_back(i);
     }
 
-    remainingRectIndices.clear();
-    for (int i = 0; i < usedRect.count(); ++i)
+    int batchSize = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    QList<AtlasBand> rendering, writing;
+    QFuture<void> written;
+    for (int firstBand = 0; firstBand < bandCount; firstBand += batchSize)
     {
-        if (!usedRect[i])
+        while (rendering.count() > std::min(batchSize, bandCount - firstBand))
+            rendering.removeLast();
+        while (rendering.count() < std::min(batchSize, bandCount - firstBand))
+            rendering.append(AtlasBand());
+        for (int i = 0; i < rendering.count(); ++i)
         {
-            remainingRectIndices.append(i);
+            rendering[i].index = firstBand + i;
+            rendering[i].firstRow = (firstBand + i) * bandRows;
+            rendering[i].rowCount = std::min(bandRows, atlas.height - rendering[i].firstRow);
         }
+
+        QtConcurrent::blockingMap(rendering, [this, &atlas, &bandEntries](AtlasBand &band)
+        {
+            renderBand(atlas, bandEntries[band.index], band);
+        });
+
+        // The bands just rendered are written while the next batch renders into the buffers of the previous one
+        written.waitForFinished();
+        rendering.swap(writing);
+        written = QtConcurrent::run([&writer, &writing, &atlas]()
+        {
+            AllocationScope allocationScope("encode: png");
+            for (const AtlasBand &band : writing)
+                writer.writeRows(band.pixels.data(), band.rowCount, atlas.width);
+        });
+    }
+    written.waitForFinished();
+}
+
+/// Streams an atlas into a PNG file in bands, see writeBands.
+/// @return False if the file could not be written.
+bool Builder::streamAtlas(const Data &atlas, const QString &savePath)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    PngStreamWriter writer;
+    writer.setCompressed(compressesAtlases());
+    if (!writer.open(savePath, atlas.width, atlas.height))
+    {
+        buildLog.write(QString("Could not write atlas %1: %2").arg(savePath).arg(writer.errorString()));
+        return false;
+    }
+
+    writeBands(atlas, writer);
+    if (!writer.close())
+    {
+        buildLog.write(QString("Could not write atlas %1: %2").arg(savePath).arg(writer.errorString()));
+        return false;
     }
 
-    return remainingRectIndices.count();
+    buildLog.write(QString("Streamed %1x%2 atlas in %3 bands of %4 rows in %5 ms")
+                   .arg(atlas.width).arg(atlas.height)
+                   .arg((atlas.height + bandRows - 1) / bandRows).arg(bandRows)
+                   .arg(timer.elapsed()));
+    return true;
 }
 
-inline void swap(QJsonValueRef valueA, QJsonValueRef valueB)
+// Asks where to save the atlas unless an output path is set
+QString Builder::atlasSavePath()
 {
-    QJsonValue temp(valueA);
-    valueA = QJsonValue(valueB);
-    valueB = temp;
+    QString savePath = outputPath.isEmpty() ? QFileDialog::getSaveFileName(Q_NULLPTR, "Save atlas texture", Q_NULLPTR, ".png") : outputPath;
+    if (savePath.isEmpty()) return savePath;
+    return savePath + (savePath.endsWith(".png") ? "" : ".png");
+}
+
+void Builder::saveAtlas(const QImage &tex, const QString &savePath)
+{
+    if (paletteSize > 0)
+    {
+        PaletteQuantizer quantizer(paletteSize, ditherPalette);
+        QImage indexed = quantizer.quantize(tex);
+        indexed.save(savePath, "PNG", pngQuality());
+        buildLog.write(QString("Palettized atlas to %1 colors, %2 bytes, MSE %3, PSNR %4 dB")
+                       .arg(quantizer.paletteSize())
+                       .arg(QFileInfo(savePath).size())
+                       .arg(quantizer.meanSquaredError())
+                       .arg(quantizer.peakSignalToNoiseRatio()));
+    }
+    else
+    {
+        tex.save(savePath, "PNG", pngQuality());
+    }
 }
 
 void Builder::rebuild()
 {
-    for (QImage image : EmoteBuilder::frames)
+    sourceRects.clear();
+    for (int id = 0; id < frames->count(); ++id)
     {
-        addRect(image.width(), image.height());
+        QSize size = frames->size(id);
+        addRect(size.width(), size.height());
     }
 
-    Logger::write("Starting build...");
+    // The peak and the allocation report cover the whole process, concurrent builds leave them to their caller
+    bool peakReset = !concurrent && MemoryUsage::resetPeak();
+
+    buildLog.write("Starting build...");
     build();
+    if (!remainingRectIndices.empty())
+        buildLog.write(QString("%1 frames did not fit in %2 atlases").arg(remainingRectIndices.size()).arg(maxAllowedAtlasCount));
 
-    Logger::write("Starting rebuild...");
+    pieces.clear();
+    if (maxSplitPieces > 1 && emotes.isEmpty() && tileSize == 0)
+        splitFrames();
 
-    QJsonArray entries;
-    for (int atlasIndex = 0; atlasIndex < atlases.count(); atlasIndex++)
+    // Both work per frame, entries of split frames are pieces
+    if (similarityPlacement && tileSize == 0 && pieces.empty())
+        arrangeBySimilarity();
+
+    meshes.clear();
+    if (meshVertexBudget > 0 && pieces.empty())
+        buildMeshes();
+
+    buildLog.write("Starting rebuild...");
+    QElapsedTimer timer;
+    timer.start();
+
+    // Atlases are encoded on their own thread while the next one renders. The queue holds one rendered atlas, so at
+    // most three are in memory: one rendering, one queued and one encoding, plus the detail levels of the one rendering.
+    BoundedQueue<EncodeJob> encodeQueue(1);
+    QThreadPool encodePool;
+    encodePool.setMaxThreadCount(1);
+    QFuture<void> encoder = QtConcurrent::run(&encodePool, [this, &encodeQueue]()
     {
-        QImage tex(atlases[atlasIndex].width, atlases[atlasIndex].height, QImage::Format_ARGB32);
+        AllocationScope allocationScope("encode: png");
+        EncodeJob job;
+        while (encodeQueue.pop(job))
+            saveAtlas(job.image, job.path);
+    });
+
+    AllocationScope allocationScope("encode: metadata");
+    if (!emotes.isEmpty())
+        saveSharedAtlases(encodeQueue);
+    else if (tileSize > 0)
+        saveTiledAtlas(encodeQueue);
+    else if (!pieces.empty())
+        saveSplitAtlases(encodeQueue);
+    else
+        saveAtlases(encodeQueue);
+
+    qint64 renderTime = timer.elapsed();
+    encodeQueue.close();
+    encoder.waitForFinished();
+    buildLog.write(QString("Rendered %1 atlases in %2 ms, encoding finished %3 ms later")
+                   .arg(atlases.size())
+                   .arg(renderTime)
+                   .arg(timer.elapsed() - renderTime));
+
+    if (concurrent)
+        return;
 
-        for (int yy = 0; yy < tex.height(); ++yy)
+    const qint64 megabyte = 1024 * 1024;
+    buildLog.write(QString("Peak RSS %1 MB %2, frames %3 MB in memory (%4 MB of them sparse) and %5 MB spilled")
+                   .arg(MemoryUsage::peakResidentBytes() / megabyte)
+                   .arg(peakReset ? "during this build" : "since start")
+                   .arg(frames->residentBytes() / megabyte)
+                   .arg(frames->sparseBytes() / megabyte)
+                   .arg(frames->spilledBytes() / megabyte));
+
+    // Everything since the previous report, which includes loading the frames of this build
+    AllocationTracker::report();
+}
+
+// Entry region at a reduced detail level. Entries are aligned to 2^lodLevels pixels, so only the size needs rounding.
+static QJsonObject entryJson(const Entry &entry, int level)
+{
+    int round = (1 << level) - 1;
+    QJsonObject frameJson;
+    frameJson.insert("flipped", entry.flipped);
+    frameJson.insert("h", (entry.h + round) >> level);
+    frameJson.insert("w", (entry.w + round) >> level);
+    frameJson.insert("x", entry.x >> level);
+    frameJson.insert("y", entry.y >> level);
+    return frameJson;
+}
+
+// Vertices as a flat x, y list, scaled to the level like the entry region
+static QJsonObject meshJson(const SpriteMesh &mesh, int level)
+{
+    double scale = 1.0 / (1 << level);
+    QJsonArray vertices;
+    for (const QPointF &vertex : mesh.vertices)
+    {
+        vertices.append(vertex.x() * scale);
+        vertices.append(vertex.y() * scale);
+    }
+
+    QJsonArray indices;
+    for (int index : mesh.indices)
+        indices.append(index);
+
+    QJsonObject meshObj;
+    meshObj.insert("indices", indices);
+    meshObj.insert("vertices", vertices);
+    return meshObj;
+}
+
+static QJsonObject anchorJson(QPoint anchor, int level)
+{
+    QPoint scaled = anchor / (qreal)(1 << level);
+    QJsonObject anchorObj;
+    anchorObj.insert("x", scaled.x());
+    anchorObj.insert("y", scaled.y());
+    return anchorObj;
+}
+
+// Level 0 keeps the path, reduced levels go to a lodN directory next to it under the same file name
+static QString lodPath(const QString &path, int level)
+{
+    if (level == 0)
+        return path;
+
+    QFileInfo info(path);
+    QString lodDir = info.dir().filePath(QString("lod%1").arg(level));
+    QDir().mkpath(lodDir);
+    return QDir(lodDir).filePath(info.fileName());
+}
+
+/// Saves each atlas where the user picks, with a data.json for the single emote next to it.
+/// Reduced detail levels are written to lodN directories in the same layout, with entries and anchors scaled to match.
+void Builder::saveAtlases(BoundedQueue<EncodeJob> &encodeQueue)
+{
+    QList<QJsonArray> levelEntries;
+    for (int level = 0; level <= lodLevels; ++level)
+        levelEntries.append(QJsonArray());
+
+    for (int atlasIndex = 0; atlasIndex < (int)atlases.size(); atlasIndex++)
+    {
+        bool streamed = streamsAtlases();
+        QImage tex = streamed ? QImage() : renderAtlas(atlases[atlasIndex]);
+        for (const Entry &entry : atlases[atlasIndex].entries)
         {
-            for (int xx = 0; xx < tex.width(); ++xx)
+            const SpriteMesh *mesh = meshes.isEmpty() ? nullptr : &meshes[entry.index];
+            QJsonObject spriteJson = SpriteDefinition::fromEntry(entry, atlases[atlasIndex].width, atlases[atlasIndex].height,
+                                                                 anchors.value(entry.index), mesh).toJson();
+            for (int level = 0; level <= lodLevels; ++level)
             {
-                tex.setPixelColor(xx, yy, QColor(Qt::transparent));
+                QJsonObject frameJson = entryJson(entry, level);
+                frameJson.insert("index", entry.index);
+                frameJson.insert("sprite", spriteJson);
+                if (mesh)
+                    frameJson.insert("mesh", meshJson(*mesh, level));
+                levelEntries[level].append(frameJson);
             }
         }
-        for (int i = 0; i < atlases[atlasIndex].entries.count(); ++i)
+
+        buildLog.write("Saving texture...");
+        QString savePath = atlasSavePath();
+        if (savePath.isEmpty()) return;
+
+        QList<QImage> levels;
+        if (!streamed)
+        {
+            levels = LodFilter::chain(tex, lodLevels);
+            levels.prepend(tex);
+        }
+        for (int level = 0; level <= lodLevels; ++level)
         {
-            Entry entry = atlases[atlasIndex].entries[i];
-            QImage source = EmoteBuilder::frames.values()[entry.index];
-
-            QJsonObject frameJson;
-            frameJson.insert("flipped", entry.flipped);
-            frameJson.insert("h", entry.h);
-            frameJson.insert("index", entry.index);
-            frameJson.insert("w", entry.w);
-            frameJson.insert("x", entry.x);
-            frameJson.insert("y", entry.y);
-            entries.append(frameJson);
-
-            if (!entry.flipped)
+            QString path = lodPath(savePath, level);
+            if (streamed)
             {
-                for (int y = 0; y < source.height(); ++y)
-                {
-                    for (int x = 0; x < source.width(); ++x)
-                    {
-                        tex.setPixelColor(entry.x + x, tex.height() - entry.h - entry.y + y, source.pixelColor(x, y));
-                    }
-                }
+                streamAtlas(atlases[atlasIndex], path);
             }
             else
             {
-                for (int y = 0; y < source.height(); ++y)
+                EncodeJob job;
+                job.image = levels[level];
+                job.path = path;
+                encodeQueue.push(job);
+            }
+
+            QJsonArray &entries = levelEntries[level];
+            std::sort(entries.begin(), entries.end(), [](const QJsonValue &valueA, const QJsonValue &valueB)
+            {
+                return valueA.toObject()["index"].toInt() < valueB.toObject()["index"].toInt();
+            });
+            QJsonObject atlasJson;
+            QJsonArray anchorArray;
+            for (auto anchor : anchors)
+                anchorArray.append(anchorJson(anchor, level));
+            atlasJson.insert("anchors", anchorArray);
+            atlasJson.insert("entries", entries);
+            atlasJson.insert("fps", fps);
+            QJsonDocument jsonDocument(atlasJson);
+            QFile jsonFile(path + "/../data.json");
+            jsonFile.open(QFile::WriteOnly);
+            jsonFile.write(jsonDocument.toJson());
+        }
+    }
+}
+
+/// Saves every atlas as atlasN.png in one directory, next to an emotes.json that lists the pages and, for each emote,
+/// its anchors, fps and the page and region of each of its frames in animation order.
+/// Reduced detail levels are written to lodN subdirectories in the same layout.
+void Builder::saveSharedAtlases(BoundedQueue<EncodeJob> &encodeQueue)
+{
+    QString saveDir = QFileDialog::getExistingDirectory(Q_NULLPTR, "Save shared atlas pages");
+    if (saveDir.isEmpty()) return;
+
+    // Frame entries by level and frame ID, so each emote can list its frames in order regardless of the page they landed on
+    QList<QList<QJsonObject>> frameEntries;
+    QList<QJsonArray> levelPages;
+    for (int level = 0; level <= lodLevels; ++level)
+    {
+        frameEntries.append(QList<QJsonObject>());
+        for (int id = 0; id < frames->count(); ++id)
+            frameEntries[level].append(QJsonObject());
+        levelPages.append(QJsonArray());
+    }
+
+    // Anchors by frame ID for the sprite definitions
+    QList<QPoint> frameAnchors;
+    for (int id = 0; id < frames->count(); ++id)
+        frameAnchors.append(QPoint(0, 0));
+    for (const EmoteGroup &emote : emotes)
+    {
+        for (int i = 0; i < emote.frameCount && i < emote.anchors.count(); ++i)
+            frameAnchors[emote.firstFrame + i] = emote.anchors[i];
+    }
+
+    qint64 usedArea = 0, pageArea = 0;
+    for (int atlasIndex = 0; atlasIndex < (int)atlases.size(); atlasIndex++)
+    {
+        const Data &atlas = atlases[atlasIndex];
+        QString fileName = QString("atlas%1.png").arg(atlasIndex);
+        QList<QJsonObject> spriteJsons;
+        for (const Entry &entry : atlas.entries)
+        {
+            const SpriteMesh *mesh = meshes.isEmpty() ? nullptr : &meshes[entry.index];
+            spriteJsons.append(SpriteDefinition::fromEntry(entry, atlas.width, atlas.height, frameAnchors[entry.index], mesh).toJson());
+        }
+
+        bool streamed = streamsAtlases();
+        QList<QImage> levels;
+        if (!streamed)
+        {
+            QImage tex = renderAtlas(atlas);
+            levels = LodFilter::chain(tex, lodLevels);
+            levels.prepend(tex);
+        }
+
+        for (int level = 0; level <= lodLevels; ++level)
+        {
+            QString path = lodPath(QDir(saveDir).filePath(fileName), level);
+            QSize pageSize(atlas.width, atlas.height);
+            if (streamed)
+            {
+                streamAtlas(atlas, path);
+            }
+            else
+            {
+                EncodeJob job;
+                job.image = levels[level];
+                job.path = path;
+                encodeQueue.push(job);
+                pageSize = job.image.size();
+            }
+
+            QJsonObject pageJson;
+            pageJson.insert("file", fileName);
+            pageJson.insert("height", pageSize.height());
+            pageJson.insert("width", pageSize.width());
+            levelPages[level].append(pageJson);
+
+            for (int i = 0; i < (int)atlas.entries.size(); ++i)
+            {
+                const Entry &entry = atlas.entries[i];
+                QJsonObject frameJson = entryJson(entry, level);
+                frameJson.insert("page", atlasIndex);
+                frameJson.insert("sprite", spriteJsons[i]);
+                if (!meshes.isEmpty())
+                    frameJson.insert("mesh", meshJson(meshes[entry.index], level));
+                frameEntries[level][entry.index] = frameJson;
+            }
+        }
+
+        for (const Entry &entry : atlas.entries)
+            usedArea += (qint64)entry.w * entry.h;
+        pageArea += (qint64)atlas.width * atlas.height;
+    }
+
+    for (int level = 0; level <= lodLevels; ++level)
+    {
+        QJsonArray emoteArray;
+        for (const EmoteGroup &emote : emotes)
+        {
+            QJsonArray entries;
+            for (int i = 0; i < emote.frameCount; ++i)
+            {
+                QJsonObject frameJson = frameEntries[level][emote.firstFrame + i];
+                if (frameJson.isEmpty())
                 {
-                    for (int x = 0; x < source.width(); ++x)
-                    {
-                        tex.setPixelColor(entry.x + y, tex.height() - entry.h - entry.y + x, source.pixelColor(x, source.height() - y - 1));
-                    }
+                    if (level == 0)
+                        buildLog.write(QString("Emote %1 is missing frame %2, it did not fit in the atlas pages").arg(emote.name).arg(i));
+                    continue;
                 }
+
+                frameJson.insert("index", i);
+                entries.append(frameJson);
             }
+
+            QJsonArray anchorArray;
+            for (int i = 0; i < emote.frameCount; ++i)
+                anchorArray.append(anchorJson(i < emote.anchors.count() ? emote.anchors[i] : QPoint(0, 0), level));
+
+            QJsonObject emoteJson;
+            emoteJson.insert("anchors", anchorArray);
+            emoteJson.insert("entries", entries);
+            emoteJson.insert("fps", emote.fps);
+            emoteJson.insert("name", emote.name);
+            emoteArray.append(emoteJson);
+        }
+
+        QJsonObject layoutJson;
+        layoutJson.insert("emotes", emoteArray);
+        layoutJson.insert("pages", levelPages[level]);
+        QFile jsonFile(lodPath(QDir(saveDir).filePath("emotes.json"), level));
+        jsonFile.open(QFile::WriteOnly);
+        jsonFile.write(QJsonDocument(layoutJson).toJson());
+    }
+
+    buildLog.write(QString("Packed %1 emotes, %2 frames into %3 pages, occupancy %4")
+                   .arg(emotes.count())
+                   .arg(frames->count())
+                   .arg(atlases.size())
+                   .arg(pageArea > 0 ? (double)usedArea / pageArea : 0.0));
+}
+
+/// Saves the distinct tiles of all frames as one atlas where the user picks, with a data.json that describes each frame
+/// as a tile map, and reports the area saved against the packed atlases of the normal build.
+void Builder::saveTiledAtlas(BoundedQueue<EncodeJob> &encodeQueue)
+{
+    AllocationScope tileScope("render: tiles");
+    TileDeduplicator deduplicator(tileSize);
+    for (int id = 0; id < frames->count(); ++id)
+        deduplicator.addFrame(id, frames->image(id));
+
+    if (!deduplicator.layout(atlasWidth, atlasHeight))
+    {
+        buildLog.write(QString("%1 unique tiles don't fit in a %2x%3 atlas")
+                       .arg(deduplicator.uniqueTileCount())
+                       .arg(atlasWidth)
+                       .arg(atlasHeight));
+        return;
+    }
+
+    qint64 packedArea = 0;
+    for (const Data &atlas : atlases)
+        packedArea += (qint64)atlas.width * atlas.height;
+    qint64 tiledArea = (qint64)deduplicator.width() * deduplicator.height();
+    buildLog.write(QString("Tile dedup kept %1 of %2 tiles, %3 empty, atlas %4x%5 is %6 px against %7 px packed, %8% saved")
+                   .arg(deduplicator.uniqueTileCount())
+                   .arg(deduplicator.tileCount())
+                   .arg(deduplicator.emptyTileCount())
+                   .arg(deduplicator.width())
+                   .arg(deduplicator.height())
+                   .arg(tiledArea)
+                   .arg(packedArea)
+                   .arg(packedArea > 0 ? 100.0 * (packedArea - tiledArea) / packedArea : 0.0));
+
+    buildLog.write("Saving texture...");
+    QString savePath = atlasSavePath();
+    if (savePath.isEmpty()) return;
+    EncodeJob job;
+    job.image = deduplicator.render();
+    job.path = savePath;
+    encodeQueue.push(job);
+
+    // Tile positions count y from the bottom of the atlas, like entries
+    QJsonArray tiles;
+    for (int i = 0; i < deduplicator.uniqueTileCount(); ++i)
+    {
+        QPoint position = deduplicator.tilePosition(i);
+        QJsonObject tileJson;
+        tileJson.insert("x", position.x());
+        tileJson.insert("y", deduplicator.height() - position.y() - deduplicator.tileSize());
+        tiles.append(tileJson);
+    }
+
+    QJsonArray tileMaps;
+    for (const TileMap &map : deduplicator.tileMaps())
+    {
+        QJsonArray mapTiles;
+        for (int tile : map.tiles)
+            mapTiles.append(tile);
+
+        QJsonObject mapJson;
+        mapJson.insert("columns", map.columns);
+        mapJson.insert("h", map.height);
+        mapJson.insert("index", map.index);
+        mapJson.insert("rows", map.rows);
+        mapJson.insert("tiles", mapTiles);
+        mapJson.insert("w", map.width);
+        tileMaps.append(mapJson);
+    }
+
+    QJsonArray anchorArray;
+    for (auto anchor : anchors)
+        anchorArray.append(anchorJson(anchor, 0));
+
+    QJsonObject atlasJson;
+    atlasJson.insert("anchors", anchorArray);
+    atlasJson.insert("fps", fps);
+    atlasJson.insert("frames", tileMaps);
+    atlasJson.insert("tileSize", deduplicator.tileSize());
+    atlasJson.insert("tiles", tiles);
+    QFile jsonFile(savePath + "/../data.json");
+    jsonFile.open(QFile::WriteOnly);
+    jsonFile.write(QJsonDocument(atlasJson).toJson());
+}
+
+/// Saves each atlas of split frames where the user picks, with a data.json that lists the pages and, per frame, the
+/// region of every piece and where it lies in the frame. Piece offsets count y from the bottom of the frame like
+/// entries do in the atlas. Frames whose pieces share a page get a sprite definition that reassembles them, frames
+/// left whole keep the entry fields of a normal build. Detail levels are not written for split frames.
+void Builder::saveSplitAtlases(BoundedQueue<EncodeJob> &encodeQueue)
+{
+    // Entries and pages of the pieces of each frame, and how many pieces it was cut into
+    QList<QList<Entry>> frameEntries;
+    QList<QList<int>> framePages;
+    QList<int> pieceCounts;
+    for (int id = 0; id < frames->count(); ++id)
+    {
+        frameEntries.append(QList<Entry>());
+        framePages.append(QList<int>());
+        pieceCounts.append(0);
+    }
+    for (const FramePiece &piece : pieces)
+        pieceCounts[piece.frame]++;
+
+    QJsonArray pages;
+    QString savePath;
+    for (int atlasIndex = 0; atlasIndex < (int)atlases.size(); atlasIndex++)
+    {
+        const Data &atlas = atlases[atlasIndex];
+        for (const Entry &entry : atlas.entries)
+        {
+            frameEntries[pieces[entry.index].frame].append(entry);
+            framePages[pieces[entry.index].frame].append(atlasIndex);
         }
 
-        Logger::write("Saving texture...");
-        QString savePath = QFileDialog::getSaveFileName(Q_NULLPTR, "Save atlas texture", Q_NULLPTR, ".png");
+        buildLog.write("Saving texture...");
+        savePath = atlasSavePath();
         if (savePath.isEmpty()) return;
-        savePath += savePath.endsWith(".png") ? "" : ".png";
-        tex.save(savePath, "PNG", 100);
 
-        std::sort(entries.begin(), entries.end(), [](const QJsonValue &valueA, const QJsonValue &valueB)
+        if (streamsAtlases())
         {
-            return valueA.toObject()["index"].toInt() < valueB.toObject()["index"].toInt();
-        });
-        QJsonObject atlasJson;
-        QJsonArray anchors;
-        for (auto anchor : EmoteBuilder::anchors)
+            streamAtlas(atlas, savePath);
+        }
+        else
         {
-            QJsonObject anchorObj;
-            anchorObj.insert("x", anchor.x());
-            anchorObj.insert("y", anchor.y());
-            anchors.append(anchorObj);
+            EncodeJob job;
+            job.image = renderAtlas(atlas);
+            job.path = savePath;
+            encodeQueue.push(job);
         }
-        atlasJson.insert("anchors", anchors);
-        atlasJson.insert("entries", entries);
-        atlasJson.insert("fps", EmoteBuilder::fps);
-        QJsonDocument jsonDocument(atlasJson);
-        QFile jsonFile(savePath + "/../data.json");
-        jsonFile.open(QFile::WriteOnly);
-        jsonFile.write(jsonDocument.toJson());
+
+        QJsonObject pageJson;
+        pageJson.insert("file", QFileInfo(savePath).fileName());
+        pageJson.insert("height", atlas.height);
+        pageJson.insert("width", atlas.width);
+        pages.append(pageJson);
     }
+
+    QJsonArray entries;
+    for (int id = 0; id < frames->count(); ++id)
+    {
+        const QList<Entry> &pieceEntries = frameEntries[id];
+        if (pieceEntries.isEmpty() || pieceEntries.count() < pieceCounts[id])
+            continue;
+
+        QPoint anchor = anchors.value(id);
+        const Data &firstAtlas = atlases[framePages[id].first()];
+        QJsonObject frameJson;
+        if (pieceEntries.count() == 1)
+        {
+            frameJson = entryJson(pieceEntries.first(), 0);
+            frameJson.insert("sprite", SpriteDefinition::fromEntry(pieceEntries.first(), firstAtlas.width, firstAtlas.height,
+                                                                   anchor, nullptr).toJson());
+        }
+        else
+        {
+            QList<QRect> regions;
+            QJsonArray pieceArray;
+            QSize frameSize = frames->size(id);
+            for (int i = 0; i < pieceEntries.count(); ++i)
+            {
+                const FramePiece &piece = pieces[pieceEntries[i].index];
+                regions.append(QRect(piece.x, piece.y, piece.width, piece.height));
+
+                QJsonObject pieceJson = entryJson(pieceEntries[i], 0);
+                pieceJson.insert("page", framePages[id][i]);
+                pieceJson.insert("rx", piece.x);
+                pieceJson.insert("ry", frameSize.height() - piece.y - piece.height);
+                pieceArray.append(pieceJson);
+            }
+            frameJson.insert("pieces", pieceArray);
+            frameJson.insert("h", frameSize.height());
+            frameJson.insert("w", frameSize.width());
+
+            // A sprite definition addresses a single texture
+            if (framePages[id].count(framePages[id].first()) == framePages[id].count())
+            {
+                frameJson.insert("sprite", SpriteDefinition::fromPieces(pieceEntries, regions, frameSize, firstAtlas.width,
+                                                                        firstAtlas.height, anchor).toJson());
+            }
+        }
+        frameJson.insert("index", id);
+        frameJson.insert("page", framePages[id].first());
+        frameJson.insert("split", pieceEntries.count() > 1);
+        entries.append(frameJson);
+    }
+
+    QJsonArray anchorArray;
+    for (auto anchor : anchors)
+        anchorArray.append(anchorJson(anchor, 0));
+
+    QJsonObject atlasJson;
+    atlasJson.insert("anchors", anchorArray);
+    atlasJson.insert("entries", entries);
+    atlasJson.insert("fps", fps);
+    atlasJson.insert("pages", pages);
+    QFile jsonFile(savePath + "/../data.json");
+    jsonFile.open(QFile::WriteOnly);
+    jsonFile.write(QJsonDocument(atlasJson).toJson());
+}
+
+// Enables the multi-start packing search, a time budget of 0 disables it
+void Builder::setOptimization(int timeBudget, quint32 seed)
+{
+    optimizeTimeBudget = timeBudget;
+    optimizeSeed = seed;
+    optimizer = PackOptimizer(timeBudget, seed, allowRotation);
+}
+
+// Caps the exact search per atlas size in ms, 0 disables it
+void Builder::setExactPacking(int timeLimit)
+{
+    exactTimeLimit = timeLimit;
+}
+
+// Frames are read through the store without copying, the store must outlive the build
+void Builder::setFrames(const FrameStore *frames)
+{
+    this->frames = frames;
+}
+
+// Writes 8-bit palettized atlases with at most paletteSize colors, a palette size of 0 keeps ARGB32 output
+void Builder::setQuantization(int paletteSize, bool dither)
+{
+    this->paletteSize = paletteSize;
+    ditherPalette = dither;
+}
+
+// Packs the frames of several emotes into shared atlases, an empty list restores single emote output
+void Builder::setEmotes(const QList<EmoteGroup> &emotes)
+{
+    this->emotes = emotes;
+}
+
+// Single emote builds write their atlas to this path without asking, an empty path asks again on every build
+void Builder::setOutputPath(const QString &path)
+{
+    outputPath = path;
+}
+
+// Anchor of each frame of a single emote build, in frame ID order
+void Builder::setAnchors(const QList<QPoint> &anchors)
+{
+    this->anchors = anchors;
+}
+
+void Builder::setFps(int fps)
+{
+    this->fps = fps;
+}
+
+// Builds running side by side hold their log until flushed and leave process wide measurements to the caller
+void Builder::setConcurrent(bool concurrent)
+{
+    this->concurrent = concurrent;
+    buildLog.setHeld(concurrent);
+}
+
+BuildLog &Builder::log()
+{
+    return buildLog;
+}
+
+/// Takes over every packing and output parameter of another builder, but none of its inputs: frames, emotes, anchors,
+/// fps and the output path stay as they are.
+void Builder::copySettings(const Builder &other)
+{
+    maxAllowedAtlasCount = other.maxAllowedAtlasCount;
+    atlasWidth = other.atlasWidth;
+    atlasHeight = other.atlasHeight;
+    forceSquare = other.forceSquare;
+    allowOptimizeSize = other.allowOptimizeSize;
+    alignShift = other.alignShift;
+    allowRotation = other.allowRotation;
+    exactTimeLimit = other.exactTimeLimit;
+    paletteSize = other.paletteSize;
+    ditherPalette = other.ditherPalette;
+    lodLevels = other.lodLevels;
+    tileSize = other.tileSize;
+    meshVertexBudget = other.meshVertexBudget;
+    similarityPlacement = other.similarityPlacement;
+    maxSplitPieces = other.maxSplitPieces;
+    setOptimization(other.optimizeTimeBudget, other.optimizeSeed);
+}
+
+void Builder::setMaxAtlasCount(int maxAllowedAtlasCount)
+{
+    this->maxAllowedAtlasCount = maxAllowedAtlasCount;
+}
+
+// Stores a convex mesh of at most maxVertices vertices with every frame entry, 0 disables it. The budget is at least 4,
+// the frame quad every mesh falls back to.
+void Builder::setMeshVertexBudget(int maxVertices)
+{
+    meshVertexBudget = maxVertices > 0 ? std::max(maxVertices, 4) : 0;
+}
+
+// Trades frames between equal size slots so similar ones compress together, a tiled atlas is left as is. Atlases are
+// written compressed while it is on.
+void Builder::setSimilarityPlacement(bool enabled)
+{
+    similarityPlacement = enabled;
+}
+
+// Single emote builds store each distinct tile of tileSize pixels once and describe frames as tile maps, 0 disables it
+void Builder::setTileSize(int tileSize)
+{
+    this->tileSize = tileSize;
+}
+
+// Single emote builds may cut frames into up to maxPieces rects packed on their own, below 2 disables it
+void Builder::setFrameSplitting(int maxPieces)
+{
+    maxSplitPieces = maxPieces;
+}
+
+// Also writes levels half, quarter... the size of each atlas. Packing switches to cells of 2^levels pixels so the
+// box filter of every level stays within one sprite.
+void Builder::setLodLevels(int levels)
+{
+    lodLevels = levels;
+    alignShift = levels;
 }
 
 void Builder::run()
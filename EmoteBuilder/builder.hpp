@@ -1,36 +1,45 @@
 #ifndef BUILDER_HPP
 #define BUILDER_HPP
 
+#include <QList>
 #include <QObject>
+#include <QPoint>
 #include <QRunnable>
-#include "max_rects_bin_pack.hpp"
+#include <QString>
+#include "atlas_layout.hpp"
+#include "bounded_queue.hpp"
+#include "frame_splitter.hpp"
+#include "frame_store.hpp"
+#include "logger.hpp"
+#include "pack_optimizer.hpp"
+#include "png_stream_writer.hpp"
+#include "sprite_mesh.hpp"
 
-class Entry
+// A rendered atlas waiting for the encoder thread
+class EncodeJob
 {
 public:
-    int             index, x, y, w, h;
-    bool            flipped;
+    QImage          image;
+    QString         path;
 };
 
-class Data
+// A named animation whose frames occupy a contiguous ID range of the frame store, packed alongside other emotes
+class EmoteGroup
 {
 public:
-    int             width, height;
-    float           occupancy;
-    QList<Entry>    entries;
-
-    Entry findEntryWithIndex(int index)
-    {
-        for (Entry entry : entries)
-        {
-            if (index == entry.index)
-            {
-                return entry;
-            }
-        }
+    QString         name;
+    int             fps;
+    QList<QPoint>   anchors;
+    int             firstFrame, frameCount;
+};
 
-        return *new Entry();
-    }
+// A horizontal strip of an atlas page, rendered on its own before it is streamed to the encoder
+class AtlasBand
+{
+public:
+    int             index;
+    int             firstRow, rowCount;
+    std::vector<uint32_t> pixels;
 };
 
 class Builder : public QObject, public QRunnable
@@ -39,12 +48,48 @@ class Builder : public QObject, public QRunnable
 public:
     Builder(int atlasWidth, int atlasHeight, int maxAllowedAtlasCount, bool allowOptimizeSize, bool forceSquare, bool allowRotation, QObject* parent = Q_NULLPTR);
     void addRect(int width, int height);
-    MaxRectsBinPack findBestBinPacker(int width, int height, QList<RectSize> &currRects, bool &allUsed);
+    MaxRectsBinPack &findBestBinPacker(PackerPool &pool, int width, int height, const std::vector<RectSize> &currRects, bool &allUsed);
     int build();
     void rebuild();
     void run() override;
+    void setOptimization(int timeBudget, quint32 seed);
+    void setExactPacking(int timeLimit);
+    void setFrames(const FrameStore *frames);
+    void setQuantization(int paletteSize, bool dither);
+    void setEmotes(const QList<EmoteGroup> &emotes);
+    void setMaxAtlasCount(int maxAllowedAtlasCount);
+    void setOutputPath(const QString &path);
+    void setAnchors(const QList<QPoint> &anchors);
+    void setFps(int fps);
+    void setConcurrent(bool concurrent);
+    void copySettings(const Builder &other);
+    BuildLog &log();
+    void setLodLevels(int levels);
+    void setTileSize(int tileSize);
+    void setMeshVertexBudget(int maxVertices);
+    void setSimilarityPlacement(bool enabled);
+    void setFrameSplitting(int maxPieces);
 
 private:
+    void buildMeshes();
+    void arrangeBySimilarity();
+    qint64 encodedSize(const Data &atlas);
+    void splitFrames();
+    QString atlasSavePath();
+    FramePixels entryPixels(const Entry &entry, QImage &source) const;
+    QImage renderAtlas(const Data &atlas);
+    bool streamsAtlases() const;
+    bool compressesAtlases() const;
+    int pngQuality() const;
+    void renderBand(const Data &atlas, const std::vector<int> &entryIndices, AtlasBand &band) const;
+    void writeBands(const Data &atlas, PngStreamWriter &writer);
+    bool streamAtlas(const Data &atlas, const QString &savePath);
+    void saveAtlas(const QImage &tex, const QString &savePath);
+    void saveAtlases(BoundedQueue<EncodeJob> &encodeQueue);
+    void saveSharedAtlases(BoundedQueue<EncodeJob> &encodeQueue);
+    void saveTiledAtlas(BoundedQueue<EncodeJob> &encodeQueue);
+    void saveSplitAtlases(BoundedQueue<EncodeJob> &encodeQueue);
+
     int             maxAllowedAtlasCount = 0;
     int             atlasWidth = 0;
     int             atlasHeight = 0;
@@ -52,13 +97,46 @@ private:
     bool            allowOptimizeSize = true;
     int             alignShift = 0;
     bool            allowRotation = true;
+    int             optimizeTimeBudget = 0;
+    quint32         optimizeSeed = 0;
+    int             exactTimeLimit = 0;
+    int             paletteSize = 0;
+    bool            ditherPalette = false;
+    int             lodLevels = 0;
+    int             tileSize = 0;
+    int             meshVertexBudget = 0;
+    bool            similarityPlacement = false;
+    int             maxSplitPieces = 0;
+    QString         outputPath;
 
-    QList<RectSize> sourceRects;
+    const FrameStore *frames = nullptr;
+    QList<EmoteGroup> emotes;
+    QList<QPoint>   anchors;
+    int             fps = 12;
+    bool            concurrent = false;
+    BuildLog        buildLog;
+    std::vector<RectSize> sourceRects;
+    QList<SpriteMesh> meshes;
+    std::vector<FramePiece> pieces; // With split frames, entries index these instead of frames
 
-    QList<Data>     atlases;
-    QList<int>      remainingRectIndices;
+    AtlasLayout     layout;
+    PackOptimizer   optimizer;
+    std::vector<Data> atlases;
+    std::vector<int> remainingRectIndices;
 
     bool            oversizeTextures = false;
+
+    static const int bandRows = 64;
+};
+
+/// A single emote build that owns everything it reads and writes: its frames, and a builder holding its parameters,
+/// anchors, fps, output path and log. Jobs share no state, so any number of them can run at once.
+class BuildJob
+{
+public:
+    QString         name;
+    QSharedPointer<FrameStore> frames;
+    QSharedPointer<Builder> builder;
 };
 
 #endif // BUILDER_HPP
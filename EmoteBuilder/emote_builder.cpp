@@ -1,17 +1,38 @@
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
 #include <QStackedLayout>
 #include <QStandardPaths>
+#include <QThread>
+#include "allocation_tracker.hpp"
+#include "build_scheduler.hpp"
 #include "emote_builder.hpp"
+#include "frame_pipeline.hpp"
+#include "frame_source.hpp"
 #include "logger.hpp"
 #include "./ui_emote_builder.h"
 
-QList<QPoint> EmoteBuilder::anchors;
-QMap<QString, QImage> EmoteBuilder::frames;
-int EmoteBuilder::fps;
+// Most atlas pages a shared build may produce, frames beyond them are reported and left out
+static const int sharedPageLimit = 16;
+// Frames held between load stages, the cap on decoded frames in flight
+static const int pipelineDepth = 8;
+// Default size limit of the decoded frame cache in MB
+static const int frameCacheLimit = 1024;
+// Quiet time in ms after the last change to a watched file before rebuilding
+static const int watchDebounceInterval = 300;
+static const QStringList sharedFrameFilters = { "*.png", "*.gif", "*.apng", "*.webp", "*.json" };
 
 EmoteBuilder::EmoteBuilder(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::EmoteBuilder)
+    , frameCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/frames", (qint64)frameCacheLimit * 1024 * 1024)
+    , frameWatcher(watchDebounceInterval)
 {
     ui->setupUi(this);
 
@@ -19,6 +40,7 @@ EmoteBuilder::EmoteBuilder(QWidget *parent)
     Logger::open(localDir + "EmoteBuilder/Log.txt");
 
     builder = new Builder(4096, 4096, 1, true, false, true);
+    builder->setFrames(&frames);
 
     QStackedLayout *stackedView = new QStackedLayout();
     ui->viewLayout->addLayout(stackedView);
@@ -29,6 +51,7 @@ EmoteBuilder::EmoteBuilder(QWidget *parent)
 
     connect(&currentAnimation, &SpriteAnimation::frameNumberChanged, this, &EmoteBuilder::updateFrameDisplay);
     connect(&currentAnimation, &SpriteAnimation::frameChanged, this, &EmoteBuilder::updatePixmap);
+    connect(&frameWatcher, &FrameWatcher::framesChanged, this, &EmoteBuilder::rebuildWatchedFrames);
 }
 
 EmoteBuilder::~EmoteBuilder()
@@ -48,52 +71,35 @@ void EmoteBuilder::updatePixmap(QPixmap pixmap)
     ui->spriteView->setPixmap(pixmap);
 }
 
-QImage trimImage(QImage image)
-{
-    int width = image.width();
-    int height = image.height();
-    int top = height / 2;
-    int bottom = top;
-    int left = width / 2 ;
-    int right = left;
-    for (int x = 0; x < width; x++) {
-        for (int y = 0; y < height; y++) {
-            if (image.pixelColor(x, y).alpha() != 0){
-                top    = std::min(top, y);
-                bottom = std::max(bottom, y);
-                left   = std::min(left, x);
-                right  = std::max(right, x);
-            }
-        }
-    }
-
-    return image.copy(left, top, right - left + 1, bottom - top + 1);
-}
-
 void EmoteBuilder::on_loadSpritesButton_clicked()
 {
     anchors.clear();
     frames.clear();
 
-    QStringList imagePaths = QFileDialog::getOpenFileNames(Q_NULLPTR, "Select sprites", Q_NULLPTR, "*.png");
-    for (QString imagePath : imagePaths)
+    FrameBatch batch;
+    batch.paths = QFileDialog::getOpenFileNames(Q_NULLPTR, "Select sprites", Q_NULLPTR, "Sprites (*.png *.gif *.apng *.webp *.json)");
+    FramePipeline(pipelineDepth, &frameCache).load({ batch }, frames);
+    for (int id = 0; id < frames.count(); ++id)
     {
-        QImage frame(imagePath);
-        QImage trimmedFrame = trimImage(frame);
-        QFileInfo imageInfo(imagePath);
-        frames.insert(imageInfo.baseName(), trimmedFrame);
         anchors.append(QPoint(0, 0));
     }
 
+    showFrames();
+}
+
+// Restarts the preview animation with the frames in the store
+void EmoteBuilder::showFrames()
+{
     if (frames.count() <= 0) return;
 
     ui->promptLabel->hide();
     ui->buildAtlasButton->setEnabled(true);
 
+    AllocationScope allocationScope("preview: pixmaps");
     QList<QPixmap> pixmaps;
-    for (auto frame : frames.values())
+    for (int id = 0; id < frames.count(); ++id)
     {
-        pixmaps.append(QPixmap::fromImage(frame));
+        pixmaps.append(QPixmap::fromImage(frames.image(id)));
     }
 
     if (currentAnimation.isPlaying())
@@ -107,11 +113,18 @@ void EmoteBuilder::on_loadSpritesButton_clicked()
     currentAnimation.play();
 }
 
-void EmoteBuilder::on_buildAtlasButton_clicked()
+// The fps typed in, 12 while the input isn't a number
+int EmoteBuilder::displayedFps() const
 {
     bool validFPS;
-    int _fps = ui->fpsInput->displayText().toInt(&validFPS);
-    fps = validFPS ? _fps : 12;
+    int fps = ui->fpsInput->displayText().toInt(&validFPS);
+    return validFPS ? fps : 12;
+}
+
+void EmoteBuilder::on_buildAtlasButton_clicked()
+{
+    builder->setAnchors(anchors);
+    builder->setFps(displayedFps());
     builder->run();
 }
 
@@ -126,9 +139,9 @@ void EmoteBuilder::on_playButton_clicked()
     }
 
     QList<QPixmap> pixmaps;
-    for (auto frame : frames.values())
+    for (int id = 0; id < frames.count(); ++id)
     {
-        pixmaps.append(QPixmap::fromImage(frame));
+        pixmaps.append(QPixmap::fromImage(frames.image(id)));
     }
 
     bool validFPS;
@@ -228,3 +241,334 @@ void EmoteBuilder::on_anchorYInput_textChanged(const QString &value)
     }
 }
 
+
+/// Reads every subdirectory of the root as one emote. A data.json from a single emote build provides its anchors and
+/// fps, every other file is a frame source, except the images of sprite sheets, which are read through their
+/// descriptions, and the atlas*.png pages of the build that wrote the data.json. Frame names are prefixed with the
+/// emote, so equally named frames of different emotes don't replace each other in a shared store.
+void EmoteBuilder::readEmoteDirectories(const QString &rootPath, QList<EmoteGroup> &emotes, QList<FrameBatch> &batches) const
+{
+    QFileInfoList emoteDirs = QDir(rootPath).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (const QFileInfo &emoteDir : emoteDirs)
+    {
+        EmoteGroup emote;
+        emote.name = emoteDir.fileName();
+        emote.fps = displayedFps();
+
+        FrameBatch batch;
+        batch.prefix = emote.name + "/";
+
+        QDir dir(emoteDir.filePath());
+        QFileInfoList files = dir.entryInfoList(sharedFrameFilters, QDir::Files);
+        bool hasBuildOutput = dir.exists("data.json");
+        QSet<QString> skippedPaths;
+        for (const QFileInfo &fileInfo : files)
+        {
+            QString suffix = fileInfo.suffix().toLower();
+            if (suffix == "json" && fileInfo.fileName() != "data.json")
+                skippedPaths.insert(QFileInfo(SpriteSheetSource::imagePath(fileInfo.filePath())).canonicalFilePath());
+            else if (suffix == "png" && hasBuildOutput && fileInfo.fileName().startsWith("atlas"))
+                skippedPaths.insert(fileInfo.canonicalFilePath());
+        }
+        skippedPaths.remove(QString());
+
+        for (const QFileInfo &fileInfo : files)
+        {
+            if (skippedPaths.contains(fileInfo.canonicalFilePath()))
+                continue;
+
+            if (fileInfo.fileName() == "data.json")
+            {
+                QFile jsonFile(fileInfo.filePath());
+                jsonFile.open(QFile::ReadOnly);
+                QJsonObject definition = QJsonDocument::fromJson(jsonFile.readAll()).object();
+                emote.fps = definition.value("fps").toInt(emote.fps);
+                for (const QJsonValue &anchor : definition.value("anchors").toArray())
+                {
+                    emote.anchors.append(QPoint(anchor.toObject().value("x").toInt(), anchor.toObject().value("y").toInt()));
+                }
+                continue;
+            }
+
+            batch.paths.append(fileInfo.filePath());
+        }
+
+        emotes.append(emote);
+        batches.append(batch);
+    }
+}
+
+
+void EmoteBuilder::on_actionBuildSharedAtlas_triggered()
+{
+    // Every subdirectory of the chosen directory is one emote, all of their frames share the atlas pages
+    QString rootPath = QFileDialog::getExistingDirectory(this, "Select emotes directory");
+    if (rootPath.isEmpty()) return;
+
+    QList<EmoteGroup> emotes;
+    QList<FrameBatch> batches;
+    readEmoteDirectories(rootPath, emotes, batches);
+
+    // All emotes go through one pipeline, so the next emote is decoded while the frames of the previous one are trimmed
+    FrameStore sharedFrames;
+    sharedFrames.setMemoryBudget((qint64)memoryBudget * 1024 * 1024);
+    QList<int> frameCounts = FramePipeline(pipelineDepth, &frameCache).load(batches, sharedFrames);
+    int firstFrame = 0;
+    for (int i = 0; i < emotes.count(); ++i)
+    {
+        emotes[i].firstFrame = firstFrame;
+        emotes[i].frameCount = frameCounts[i];
+        firstFrame += frameCounts[i];
+    }
+
+    // Emotes without frames would only produce empty entries
+    emotes.erase(std::remove_if(emotes.begin(), emotes.end(), [](const EmoteGroup &emote)
+    {
+        return emote.frameCount == 0;
+    }), emotes.end());
+
+    if (emotes.isEmpty()) return;
+
+    builder->setFrames(&sharedFrames);
+    builder->setEmotes(emotes);
+    builder->setMaxAtlasCount(sharedPageLimit);
+    builder->run();
+
+    builder->setFrames(&frames);
+    builder->setEmotes(QList<EmoteGroup>());
+    builder->setMaxAtlasCount(1);
+}
+
+
+/// Builds every emote directory into an atlas of its own, under a directory of the same name in the chosen output
+/// directory. Frames are loaded one emote after another, then the builds run side by side on every core. Each build is
+/// a job with its own frames, parameters copied from the current ones, output path and log, so the files written are
+/// the same as if the emotes were built one at a time.
+void EmoteBuilder::on_actionBuildEachEmote_triggered()
+{
+    QString rootPath = QFileDialog::getExistingDirectory(this, "Select emotes directory");
+    if (rootPath.isEmpty()) return;
+    QString outputDir = QFileDialog::getExistingDirectory(this, "Save emote atlases");
+    if (outputDir.isEmpty()) return;
+
+    QList<EmoteGroup> emotes;
+    QList<FrameBatch> batches;
+    readEmoteDirectories(rootPath, emotes, batches);
+
+    QElapsedTimer timer;
+    timer.start();
+    QList<BuildJob> jobs;
+    for (int i = 0; i < emotes.count(); ++i)
+    {
+        BuildJob job;
+        job.name = emotes[i].name;
+        job.frames.reset(new FrameStore());
+        job.frames->setMemoryBudget((qint64)memoryBudget * 1024 * 1024);
+
+        // Every emote has a store of its own, so its frames keep their plain names
+        batches[i].prefix.clear();
+        FramePipeline(pipelineDepth, &frameCache).load({ batches[i] }, *job.frames);
+        if (job.frames->isEmpty()) continue;
+
+        QList<QPoint> frameAnchors = emotes[i].anchors.mid(0, job.frames->count());
+        while (frameAnchors.count() < job.frames->count())
+            frameAnchors.append(QPoint(0, 0));
+
+        QString emoteDir = QDir(outputDir).filePath(job.name);
+        QDir().mkpath(emoteDir);
+
+        job.builder.reset(new Builder(4096, 4096, 1, true, false, true));
+        job.builder->copySettings(*builder);
+        job.builder->setFrames(job.frames.data());
+        job.builder->setAnchors(frameAnchors);
+        job.builder->setFps(emotes[i].fps);
+        job.builder->setOutputPath(QDir(emoteDir).filePath("atlas.png"));
+        job.builder->setConcurrent(true);
+        jobs.append(job);
+    }
+    qint64 loadTime = timer.elapsed();
+
+    // Emotes with the most frames first, so the longest builds don't start last
+    QList<BuildJob> largestFirst = jobs;
+    std::stable_sort(largestFirst.begin(), largestFirst.end(), [](const BuildJob &jobA, const BuildJob &jobB)
+    {
+        return jobA.frames->count() > jobB.frames->count();
+    });
+
+    QList<BuildTask> tasks;
+    for (const BuildJob &job : largestFirst)
+    {
+        QSharedPointer<Builder> jobBuilder = job.builder;
+        tasks.append([jobBuilder]()
+        {
+            jobBuilder->rebuild();
+        });
+    }
+
+    BuildScheduler scheduler(QThread::idealThreadCount());
+    scheduler.run(tasks);
+
+    // In directory order, the order a serial run logs them in
+    for (const BuildJob &job : jobs)
+    {
+        Logger::write(QString("Build of emote %1:").arg(job.name));
+        job.builder->log().flush();
+    }
+
+    Logger::write(QString("Built %1 emotes on %2 workers in %3 ms after loading them in %4 ms, %5 builds stolen")
+                  .arg(jobs.count())
+                  .arg(scheduler.workerCount())
+                  .arg(timer.elapsed() - loadTime)
+                  .arg(loadTime)
+                  .arg(scheduler.stealCount()));
+    AllocationTracker::report();
+}
+
+
+void EmoteBuilder::on_actionMemoryBudget_triggered()
+{
+    bool ok;
+    int budget = QInputDialog::getInt(this, "Memory Budget", "Decoded frame budget in MB, frames beyond it are spilled to disk (0 for unlimited):",
+                                      memoryBudget, 0, 1024 * 1024, 64, &ok);
+    if (!ok) return;
+
+    memoryBudget = budget;
+    frames.setMemoryBudget((qint64)memoryBudget * 1024 * 1024);
+}
+
+// Watch mode rebuilds the atlas of one frames directory to a fixed path whenever its files change
+void EmoteBuilder::on_actionWatchDirectory_toggled(bool checked)
+{
+    if (!checked)
+    {
+        frameWatcher.stop();
+        builder->setOutputPath(QString());
+        ui->statusBar->showMessage("Watch mode off");
+        return;
+    }
+
+    QString directory = QFileDialog::getExistingDirectory(this, "Select frames directory to watch");
+    QString savePath = directory.isEmpty() ? QString() : QFileDialog::getSaveFileName(this, "Save atlas texture", Q_NULLPTR, ".png");
+    if (savePath.isEmpty())
+    {
+        ui->actionWatchDirectory->setChecked(false);
+        return;
+    }
+    savePath += savePath.endsWith(".png") ? "" : ".png";
+
+    // The output may live in the watched directory, writing it must not trigger another build
+    builder->setOutputPath(savePath);
+    frameWatcher.start(directory, { savePath });
+    rebuildWatchedFrames(frameWatcher.framePaths(), true, QDateTime::currentMSecsSinceEpoch());
+}
+
+/// Re-decodes the changed files, repacks and rewrites the atlas. Changed files replace their frames in place so anchors
+/// stay with their frames, added or removed files reload the directory since frame order follows file names.
+void EmoteBuilder::rebuildWatchedFrames(const QStringList &changedPaths, bool filesAddedOrRemoved, qint64 savedAt)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    int countBefore = frames.count();
+    FrameBatch batch;
+    batch.paths = filesAddedOrRemoved ? frameWatcher.framePaths() : changedPaths;
+    if (filesAddedOrRemoved)
+        frames.clear();
+    FramePipeline(pipelineDepth, &frameCache).load({ batch }, frames);
+
+    // An animated file that gained frames appends them after every other frame, out of order
+    if (!filesAddedOrRemoved && frames.count() != countBefore)
+    {
+        frames.clear();
+        batch.paths = frameWatcher.framePaths();
+        FramePipeline(pipelineDepth, &frameCache).load({ batch }, frames);
+    }
+
+    while (anchors.count() < frames.count())
+        anchors.append(QPoint(0, 0));
+    while (anchors.count() > frames.count())
+        anchors.removeLast();
+
+    showFrames();
+    if (frames.isEmpty()) return;
+
+    builder->setAnchors(anchors);
+    builder->setFps(displayedFps());
+    builder->run();
+
+    QString message = QString("Rebuilt %1 changed files in %2 ms, atlas updated %3 ms after save")
+                      .arg(changedPaths.count())
+                      .arg(timer.elapsed())
+                      .arg(QDateTime::currentMSecsSinceEpoch() - savedAt);
+    Logger::write(message);
+    ui->statusBar->showMessage(message);
+}
+
+void EmoteBuilder::on_actionFrameCacheSize_triggered()
+{
+    bool ok;
+    int limit = QInputDialog::getInt(this, "Frame Cache Size", "Decoded frame cache size in MB, least recently used files beyond it are removed (0 disables the cache):",
+                                     (int)(frameCache.sizeLimit() / (1024 * 1024)), 0, 1024 * 1024, 256, &ok);
+    if (!ok) return;
+
+    frameCache.setSizeLimit((qint64)limit * 1024 * 1024);
+}
+
+
+void EmoteBuilder::on_actionOptimizePacking_toggled(bool checked)
+{
+    // Spend up to 2 seconds per atlas size searching packing orders, seeded for reproducible layouts
+    builder->setOptimization(checked ? 2000 : 0, 0);
+}
+
+
+void EmoteBuilder::on_actionExactPacking_toggled(bool checked)
+{
+    // Decide small frame sets the heuristics can't fit exactly, spending up to a second per atlas size
+    builder->setExactPacking(checked ? 1000 : 0);
+}
+
+
+void EmoteBuilder::on_actionPalettizedOutput_toggled(bool checked)
+{
+    builder->setQuantization(checked ? 256 : 0, ui->actionDitherPalette->isChecked());
+}
+
+
+void EmoteBuilder::on_actionDitherPalette_toggled(bool checked)
+{
+    builder->setQuantization(ui->actionPalettizedOutput->isChecked() ? 256 : 0, checked);
+}
+
+
+void EmoteBuilder::on_actionLodVariants_toggled(bool checked)
+{
+    // Half and quarter size atlases next to the full size one
+    builder->setLodLevels(checked ? 2 : 0);
+}
+
+
+void EmoteBuilder::on_actionTileDedup_toggled(bool checked)
+{
+    builder->setTileSize(checked ? 16 : 0);
+}
+
+
+void EmoteBuilder::on_actionPolygonMeshes_toggled(bool checked)
+{
+    // Eight vertices hug most shapes closely while staying cheaper than the overdraw they save
+    builder->setMeshVertexBudget(checked ? 8 : 0);
+}
+
+
+void EmoteBuilder::on_actionSimilarityPlacement_toggled(bool checked)
+{
+    builder->setSimilarityPlacement(checked);
+}
+
+
+void EmoteBuilder::on_actionSplitFrames_toggled(bool checked)
+{
+    // Up to four pieces covers L shapes and a detached effect or two without many extra quads
+    builder->setFrameSplitting(checked ? 4 : 0);
+}
@@ -4,6 +4,10 @@
 #include <QMainWindow>
 #include <QPixmap>
 #include "builder.hpp"
+#include "frame_cache.hpp"
+#include "frame_pipeline.hpp"
+#include "frame_store.hpp"
+#include "frame_watcher.hpp"
 #include "sprite_animation.hpp"
 
 QT_BEGIN_NAMESPACE
@@ -18,10 +22,6 @@ public:
     EmoteBuilder(QWidget *parent = nullptr);
     ~EmoteBuilder();
 
-    static QList<QPoint>            anchors;
-    static QMap<QString, QImage>    frames;
-    static int                      fps;
-
 private slots:
     void on_loadSpritesButton_clicked();
     void on_buildAtlasButton_clicked();
@@ -31,13 +31,36 @@ private slots:
     void on_nextFrameButton_clicked();
     void on_anchorXInput_textChanged(const QString &arg1);
     void on_anchorYInput_textChanged(const QString &arg1);
+    void on_actionBuildSharedAtlas_triggered();
+    void on_actionBuildEachEmote_triggered();
+    void on_actionMemoryBudget_triggered();
+    void on_actionFrameCacheSize_triggered();
+    void on_actionWatchDirectory_toggled(bool checked);
+    void on_actionOptimizePacking_toggled(bool checked);
+    void on_actionExactPacking_toggled(bool checked);
+    void on_actionPalettizedOutput_toggled(bool checked);
+    void on_actionDitherPalette_toggled(bool checked);
+    void on_actionLodVariants_toggled(bool checked);
+    void on_actionTileDedup_toggled(bool checked);
+    void on_actionPolygonMeshes_toggled(bool checked);
+    void on_actionSimilarityPlacement_toggled(bool checked);
+    void on_actionSplitFrames_toggled(bool checked);
 
 private:
     void updateFrameDisplay(int frameNumber);
     void updatePixmap(QPixmap pixmap);
+    void showFrames();
+    int displayedFps() const;
+    void readEmoteDirectories(const QString &rootPath, QList<EmoteGroup> &emotes, QList<FrameBatch> &batches) const;
+    void rebuildWatchedFrames(const QStringList &changedPaths, bool filesAddedOrRemoved, qint64 savedAt);
 
     Ui::EmoteBuilder    *ui;
     Builder*            builder;
+    FrameStore          frames;
+    QList<QPoint>       anchors;
+    FrameCache          frameCache;
+    FrameWatcher        frameWatcher;
+    int                 memoryBudget = 0; // MB, 0 for unlimited
     SpriteAnimation     currentAnimation;
 };
 #endif // EMOTE_BUILDER_HPP
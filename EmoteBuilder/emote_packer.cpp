@@ -0,0 +1,190 @@
+#include <memory>
+#include "atlas_renderer.hpp"
+#include "emote_packer.h"
+
+struct EmoteLayout
+{
+    std::vector<RectSize> sizes;
+    std::vector<Data> atlases;
+    int             unplacedCount;
+};
+
+// Beyond this the alignment masks overflow int
+static const int maxAlignShift = 15;
+
+// Every entry point catches exceptions, since they must not unwind into C callers
+EmoteLayout *emote_pack(const EmotePackSettings *settings, const int32_t *sizes, int32_t count)
+{
+    if (!settings || (count > 0 && !sizes) || count < 0 || settings->alignShift < 0 || settings->alignShift > maxAlignShift ||
+        settings->gutter < 0 || settings->atlasWidth <= 0 || settings->atlasHeight <= 0 || settings->maxAtlasCount <= 0)
+    {
+        return nullptr;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (sizes[i * 2] <= 0 || sizes[i * 2 + 1] <= 0)
+            return nullptr;
+    }
+
+    try
+    {
+        std::unique_ptr<EmoteLayout> layout(new EmoteLayout());
+        for (int i = 0; i < count; ++i)
+        {
+            RectSize rs;
+            rs.width = sizes[i * 2];
+            rs.height = sizes[i * 2 + 1];
+            layout->sizes.push_back(rs);
+        }
+
+        AtlasLayout atlasLayout(settings->atlasWidth, settings->atlasHeight, settings->maxAtlasCount,
+                                settings->allowOptimizeSize != 0, settings->forceSquare != 0, settings->allowRotation != 0);
+        atlasLayout.setAlignment(settings->alignShift, settings->gutter);
+        layout->unplacedCount = atlasLayout.build(layout->sizes);
+        layout->atlases = atlasLayout.getAtlases();
+        return layout.release();
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+int32_t emote_layout_atlas_count(const EmoteLayout *layout)
+{
+    try
+    {
+        return layout ? (int32_t)layout->atlases.size() : 0;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+int32_t emote_layout_atlas_size(const EmoteLayout *layout, int32_t atlas, int32_t *width, int32_t *height)
+{
+    try
+    {
+        if (!layout || atlas < 0 || atlas >= (int32_t)layout->atlases.size())
+            return 0;
+
+        if (width)
+            *width = layout->atlases[atlas].width;
+        if (height)
+            *height = layout->atlases[atlas].height;
+        return 1;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+int32_t emote_layout_placement_count(const EmoteLayout *layout)
+{
+    try
+    {
+        if (!layout)
+            return 0;
+
+        size_t count = 0;
+        for (const Data &atlas : layout->atlases)
+            count += atlas.entries.size();
+        return (int32_t)count;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+void emote_layout_placements(const EmoteLayout *layout, EmotePlacement *placements)
+{
+    try
+    {
+        if (!layout || !placements)
+            return;
+
+        for (size_t a = 0; a < layout->atlases.size(); ++a)
+        {
+            for (const Entry &entry : layout->atlases[a].entries)
+            {
+                EmotePlacement &placement = *placements++;
+                placement.index = entry.index;
+                placement.atlas = (int32_t)a;
+                placement.x = entry.x;
+                placement.y = entry.y;
+                placement.w = entry.w;
+                placement.h = entry.h;
+                placement.flipped = entry.flipped ? 1 : 0;
+            }
+        }
+    }
+    catch (...)
+    {
+    }
+}
+
+int32_t emote_layout_unplaced_count(const EmoteLayout *layout)
+{
+    try
+    {
+        return layout ? layout->unplacedCount : 0;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+int32_t emote_render_atlas(const EmoteLayout *layout, int32_t atlas, const uint32_t *const *framePixels,
+                           uint32_t *pixels, int32_t bottomUp)
+{
+    try
+    {
+        if (!layout || !framePixels || !pixels || atlas < 0 || atlas >= (int32_t)layout->atlases.size())
+            return 0;
+
+        const Data &data = layout->atlases[atlas];
+        for (const Entry &entry : data.entries)
+        {
+            if (!framePixels[entry.index])
+                return 0;
+        }
+
+        // A bottom up buffer is the same image walked from its last row with a negative stride
+        ptrdiff_t stride = bottomUp ? -(ptrdiff_t)data.width : (ptrdiff_t)data.width;
+        uint32_t *topRow = bottomUp ? pixels + (ptrdiff_t)(data.height - 1) * data.width : pixels;
+        AtlasRenderer::clear(topRow, data.width, data.height, stride);
+
+        for (const Entry &entry : data.entries)
+        {
+            const RectSize &size = layout->sizes[entry.index];
+            FramePixels frame;
+            frame.pixels = framePixels[entry.index];
+            frame.width = size.width;
+            frame.height = size.height;
+            frame.stride = size.width;
+            AtlasRenderer::blit(entry, data.height, frame, topRow, stride);
+        }
+
+        return 1;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+void emote_layout_free(EmoteLayout *layout)
+{
+    try
+    {
+        delete layout;
+    }
+    catch (...)
+    {
+    }
+}
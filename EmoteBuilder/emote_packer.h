@@ -0,0 +1,68 @@
+#ifndef EMOTE_PACKER_H
+#define EMOTE_PACKER_H
+
+/* Plain C interface to the atlas packer and renderer, for tools and runtimes that cannot link Qt or C++.
+ * Sizes and placements are in pixels, placement y counts from the bottom of the atlas as in the builder output. */
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(EMOTE_PACKER_BUILD)
+#    define EMOTE_PACKER_API __declspec(dllexport)
+#  elif defined(EMOTE_PACKER_SHARED)
+#    define EMOTE_PACKER_API __declspec(dllimport)
+#  else
+#    define EMOTE_PACKER_API
+#  endif
+#elif defined(__GNUC__)
+#  define EMOTE_PACKER_API __attribute__((visibility("default")))
+#else
+#  define EMOTE_PACKER_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct EmotePackSettings
+{
+    int32_t atlasWidth;
+    int32_t atlasHeight;
+    int32_t maxAtlasCount;
+    int32_t allowOptimizeSize;
+    int32_t forceSquare;
+    int32_t allowRotation;
+    int32_t alignShift;     /* Rects are aligned to 2^alignShift pixels */
+    int32_t gutter;         /* Extra cells on the right and top of every rect */
+} EmotePackSettings;
+
+typedef struct EmotePlacement
+{
+    int32_t index;          /* Position of the rect in the input */
+    int32_t atlas;
+    int32_t x, y, w, h;     /* w and h are swapped from the input when flipped */
+    int32_t flipped;
+} EmotePlacement;
+
+typedef struct EmoteLayout EmoteLayout;
+
+/* Packs count rects given as (width, height) pairs. Returns NULL on invalid arguments: a rect or atlas side that is not
+ * positive, maxAtlasCount below 1, alignShift outside 0..15 or a negative gutter. Also returns NULL when out of memory. */
+EMOTE_PACKER_API EmoteLayout *emote_pack(const EmotePackSettings *settings, const int32_t *sizes, int32_t count);
+EMOTE_PACKER_API int32_t emote_layout_atlas_count(const EmoteLayout *layout);
+EMOTE_PACKER_API int32_t emote_layout_atlas_size(const EmoteLayout *layout, int32_t atlas, int32_t *width, int32_t *height);
+EMOTE_PACKER_API int32_t emote_layout_placement_count(const EmoteLayout *layout);
+/* Copies every placement, ordered by atlas, into placements, which must hold emote_layout_placement_count entries */
+EMOTE_PACKER_API void emote_layout_placements(const EmoteLayout *layout, EmotePlacement *placements);
+EMOTE_PACKER_API int32_t emote_layout_unplaced_count(const EmoteLayout *layout);
+/* Draws one atlas from 32-bit frames with tightly packed rows, indexed like the input sizes. The atlas buffer holds
+ * width * height pixels, stored top down unless bottomUp is set. Returns 1 on success and 0 on invalid arguments. */
+EMOTE_PACKER_API int32_t emote_render_atlas(const EmoteLayout *layout, int32_t atlas, const uint32_t *const *framePixels,
+                                            uint32_t *pixels, int32_t bottomUp);
+EMOTE_PACKER_API void emote_layout_free(EmoteLayout *layout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMOTE_PACKER_H */
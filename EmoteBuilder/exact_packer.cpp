@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <chrono>
+#include "exact_packer.hpp"
+
+// Bins whose normal pattern grid has more cells than this are left to the heuristics
+static const long long maxGridCells = 1 << 22;
+
+// Grid cell states
+static const unsigned char cellEmpty = 0;
+static const unsigned char cellUsed = 1;
+static const unsigned char cellWaste = 2;
+
+ExactPacker::ExactPacker(bool allowRotation, int timeLimit)
+{
+    this->allowRotation = allowRotation;
+    this->timeLimit = timeLimit;
+}
+
+// Search nodes visited by the last pack
+long long ExactPacker::nodeCount() const
+{
+    return nodes;
+}
+
+/// Marks every coordinate up to length that is the sum of the sides of some subset of the rects along one axis.
+/// With rotation either side of a rect may lie along the axis.
+std::vector<unsigned char> ExactPacker::normalPatterns(int length, const std::vector<RectSize> &rects, bool allowRotation, bool horizontal)
+{
+    std::vector<unsigned char> reachable(length + 1, 0);
+    reachable[0] = 1;
+    for (const RectSize &rect : rects)
+    {
+        int side = horizontal ? rect.width : rect.height;
+        int otherSide = horizontal ? rect.height : rect.width;
+
+        // Downwards, so every rect is counted at most once per sum
+        for (int position = length; position >= 0; --position)
+        {
+            if (!reachable[position])
+                continue;
+            if (position + side <= length)
+                reachable[position + side] = 1;
+            if (allowRotation && position + otherSide <= length)
+                reachable[position + otherSide] = 1;
+        }
+    }
+
+    return reachable;
+}
+
+/// Builds the grid lines of both axes: the normal patterns where rects may start, the ends of rects starting there
+/// and the bin border.
+void ExactPacker::buildGrid(int width, int height, const std::vector<RectSize> &rects)
+{
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        bool horizontal = axis == 0;
+        int length = horizontal ? width : height;
+        std::vector<int> &lines = horizontal ? xs : ys;
+        std::vector<int> &lineOf = horizontal ? columnOf : rowOf;
+        std::vector<unsigned char> &starts = horizontal ? columnStarts : rowStarts;
+
+        std::vector<unsigned char> patterns = normalPatterns(length, rects, allowRotation, horizontal);
+        std::vector<unsigned char> isLine(patterns);
+        isLine[length] = 1;
+        for (int position = 0; position < length; ++position)
+        {
+            if (!patterns[position])
+                continue;
+            for (const RectSize &rect : rects)
+            {
+                int side = horizontal ? rect.width : rect.height;
+                int otherSide = horizontal ? rect.height : rect.width;
+                if (position + side <= length)
+                    isLine[position + side] = 1;
+                if (allowRotation && position + otherSide <= length)
+                    isLine[position + otherSide] = 1;
+            }
+        }
+
+        lines.clear();
+        starts.clear();
+        lineOf.assign(length + 1, -1);
+        for (int position = 0; position <= length; ++position)
+        {
+            if (!isLine[position])
+                continue;
+            lineOf[position] = (int)lines.size();
+            lines.push_back(position);
+            starts.push_back(position < length && patterns[position]);
+        }
+    }
+
+    // The last line of each axis is the border, so there is one cell less than lines
+    columns = (int)xs.size() - 1;
+    rows = (int)ys.size() - 1;
+}
+
+// The first empty cell at or after the given one in row order, -1 if the grid is full
+int ExactPacker::firstEmptyCell(int cell) const
+{
+    int cellCount = (int)cells.size();
+    while (cell < cellCount && cells[cell] != cellEmpty)
+        ++cell;
+    return cell < cellCount ? cell : -1;
+}
+
+long long ExactPacker::cellArea(int column, int row) const
+{
+    return (long long)(xs[column + 1] - xs[column]) * (ys[row + 1] - ys[row]);
+}
+
+void ExactPacker::fill(int column, int row, int columnEnd, int rowEnd, unsigned char value)
+{
+    for (int r = row; r < rowEnd; ++r)
+        std::fill(cells.begin() + r * columns + column, cells.begin() + r * columns + columnEnd, value);
+}
+
+/// Applies the next untried option of a decision. Options are a rect of every group in both orientations with its
+/// corner on the cell, then leaving the cell empty as the last one.
+/// @return False once every option was tried.
+bool ExactPacker::apply(ExactDecision &decision)
+{
+    int column = decision.cell % columns;
+    int row = decision.cell / columns;
+    int wasteOption = (int)groups.size() * 2;
+    bool corner = columnStarts[column] && rowStarts[row];
+
+    while (decision.nextOption <= wasteOption)
+    {
+        int option = decision.nextOption++;
+        if (option < wasteOption)
+        {
+            if (!corner)
+            {
+                decision.nextOption = wasteOption;
+                continue;
+            }
+
+            ExactGroup &group = groups[option / 2];
+            bool rotated = option % 2 == 1;
+            if (group.count == 0 || (rotated && (!allowRotation || group.width == group.height)))
+                continue;
+
+            int width = rotated ? group.height : group.width;
+            int height = rotated ? group.width : group.height;
+            int right = xs[column] + width;
+            int top = ys[row] + height;
+            if (right > xs.back() || top > ys.back())
+                continue;
+
+            // The ends of a rect starting on normal patterns are always grid lines
+            int columnEnd = columnOf[right];
+            int rowEnd = rowOf[top];
+            bool empty = true;
+            for (int r = row; r < rowEnd && empty; ++r)
+            {
+                for (int c = column; c < columnEnd; ++c)
+                {
+                    if (cells[r * columns + c] != cellEmpty)
+                    {
+                        empty = false;
+                        break;
+                    }
+                }
+            }
+            if (!empty)
+                continue;
+
+            fill(column, row, columnEnd, rowEnd, cellUsed);
+            group.count--;
+            remainingCount--;
+            remainingArea -= (long long)width * height;
+            freeArea -= (long long)width * height;
+
+            Rect rect;
+            rect.x = xs[column];
+            rect.y = ys[row];
+            rect.width = width;
+            rect.height = height;
+            placed.push_back(rect);
+
+            decision.applied = true;
+            decision.waste = false;
+            decision.group = option / 2;
+            decision.rotated = rotated;
+            decision.columnEnd = columnEnd;
+            decision.rowEnd = rowEnd;
+            return true;
+        }
+
+        // No rect can start on the empty cells to the right of this one before the next corner, so they are
+        // left empty along with it
+        int columnEnd = column + 1;
+        while (columnEnd < columns && cells[row * columns + columnEnd] == cellEmpty && !(columnStarts[columnEnd] && rowStarts[row]))
+            ++columnEnd;
+
+        long long area = 0;
+        for (int c = column; c < columnEnd; ++c)
+            area += cellArea(c, row);
+        if (freeArea - area < remainingArea)
+            return false;
+
+        fill(column, row, columnEnd, row + 1, cellWaste);
+        freeArea -= area;
+        decision.applied = true;
+        decision.waste = true;
+        decision.columnEnd = columnEnd;
+        decision.rowEnd = row + 1;
+        return true;
+    }
+
+    return false;
+}
+
+void ExactPacker::undo(ExactDecision &decision)
+{
+    int column = decision.cell % columns;
+    int row = decision.cell / columns;
+    fill(column, row, decision.columnEnd, decision.rowEnd, cellEmpty);
+    decision.applied = false;
+
+    if (decision.waste)
+    {
+        for (int c = column; c < decision.columnEnd; ++c)
+            freeArea += cellArea(c, row);
+        return;
+    }
+
+    const Rect &rect = placed.back();
+    long long area = (long long)rect.width * rect.height;
+    groups[decision.group].count++;
+    remainingCount++;
+    remainingArea += area;
+    freeArea += area;
+    placed.pop_back();
+}
+
+/// Searches for a packing of all rects into a width x height bin.
+/// @param result [out] Reset to the bin and filled with the placed rects, only when every rect was placed.
+ExactResult ExactPacker::pack(int width, int height, const std::vector<RectSize> &rects, MaxRectsBinPack &result)
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeLimit);
+    nodes = 0;
+
+    // Rects of the same size are interchangeable, so trying one of them per cell covers all of them
+    groups.clear();
+    remainingArea = 0;
+    for (const RectSize &rect : rects)
+    {
+        bool fitsUpright = rect.width <= width && rect.height <= height;
+        bool fitsRotated = allowRotation && rect.height <= width && rect.width <= height;
+        if (!fitsUpright && !fitsRotated)
+            return ExactInfeasible;
+
+        auto sameSize = [this, &rect](const ExactGroup &group)
+        {
+            return (group.width == rect.width && group.height == rect.height) ||
+                   (allowRotation && group.width == rect.height && group.height == rect.width);
+        };
+        auto group = std::find_if(groups.begin(), groups.end(), sameSize);
+        if (group != groups.end())
+        {
+            group->count++;
+        }
+        else
+        {
+            ExactGroup newGroup;
+            newGroup.width = rect.width;
+            newGroup.height = rect.height;
+            newGroup.count = 1;
+            groups.push_back(newGroup);
+        }
+        remainingArea += (long long)rect.width * rect.height;
+    }
+
+    freeArea = (long long)width * height;
+    if (remainingArea > freeArea)
+        return ExactInfeasible;
+
+    // Large rects first, they have the fewest places to go
+    std::stable_sort(groups.begin(), groups.end(), [](const ExactGroup &groupA, const ExactGroup &groupB)
+    {
+        return (long long)groupA.width * groupA.height > (long long)groupB.width * groupB.height;
+    });
+
+    buildGrid(width, height, rects);
+    if ((long long)columns * rows > maxGridCells)
+        return ExactTimedOut;
+
+    cells.assign((size_t)columns * rows, cellEmpty);
+    remainingCount = (int)rects.size();
+    placed.clear();
+    decisions.clear();
+
+    bool found = remainingCount == 0;
+    if (!found)
+    {
+        ExactDecision root;
+        root.cell = 0;
+        root.nextOption = 0;
+        root.applied = false;
+        decisions.push_back(root);
+    }
+
+    while (!found && !decisions.empty())
+    {
+        if ((++nodes & 1023) == 0 && Clock::now() > deadline)
+            return ExactTimedOut;
+
+        ExactDecision &decision = decisions.back();
+        if (decision.applied)
+            undo(decision);
+        if (!apply(decision))
+        {
+            decisions.pop_back();
+            continue;
+        }
+
+        if (remainingCount == 0)
+        {
+            found = true;
+            break;
+        }
+
+        int next = firstEmptyCell(decision.cell);
+        if (next == -1)
+            continue;
+
+        ExactDecision child;
+        child.cell = next;
+        child.nextOption = 0;
+        child.applied = false;
+        decisions.push_back(child);
+    }
+
+    if (!found)
+        return ExactInfeasible;
+
+    result.reset(width, height, allowRotation);
+    for (const Rect &rect : placed)
+        result.placeRect(rect);
+    return ExactPacked;
+}
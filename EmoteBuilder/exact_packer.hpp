@@ -0,0 +1,77 @@
+#ifndef EXACT_PACKER_HPP
+#define EXACT_PACKER_HPP
+
+#include <vector>
+#include "atlas_rect.hpp"
+#include "max_rects_bin_pack.hpp"
+
+/// Rects of one size, interchangeable during the search.
+class ExactGroup
+{
+public:
+    int             width, height;
+    int             count;
+};
+
+/// A step of the search: the empty grid cell it fills, the next option to try there and how the current one was applied.
+class ExactDecision
+{
+public:
+    int             cell;
+    int             nextOption;
+    bool            applied;
+    int             columnEnd, rowEnd;
+    int             group;
+    bool            rotated;
+    bool            waste;
+};
+
+enum ExactResult
+{
+    ExactPacked, /// Every rect was placed.
+    ExactInfeasible, /// Proven that the rects can't all fit the bin.
+    ExactTimedOut /// The time limit ran out before either was shown.
+};
+
+/// Decides by branch and bound whether a small set of rects fits a bin, for bins the greedy heuristics could not fill.
+/// Any packing can be pushed down and left until every rect rests on the bin border or on another rect, which puts
+/// every rect corner on a sum of rect sides (a normal pattern). The search works on the grid of those coordinates and
+/// always covers its lowest, then leftmost empty cell, either with the corner of a rect or by leaving the cell empty,
+/// which makes it complete. Branches are pruned when the remaining rects need more area than is left, and rects of
+/// the same size are tried only once per cell.
+class ExactPacker
+{
+public:
+    ExactPacker(bool allowRotation, int timeLimit);
+    ExactResult pack(int width, int height, const std::vector<RectSize> &rects, MaxRectsBinPack &result);
+    long long nodeCount() const;
+
+    static const int maxRectCount = 30;
+
+private:
+    void buildGrid(int width, int height, const std::vector<RectSize> &rects);
+    static std::vector<unsigned char> normalPatterns(int length, const std::vector<RectSize> &rects, bool allowRotation, bool horizontal);
+    int firstEmptyCell(int cell) const;
+    bool apply(ExactDecision &decision);
+    void undo(ExactDecision &decision);
+    long long cellArea(int column, int row) const;
+    void fill(int column, int row, int columnEnd, int rowEnd, unsigned char value);
+
+    bool            allowRotation = true;
+    int             timeLimit = 0; // ms
+
+    std::vector<int> xs, ys; // Grid lines
+    std::vector<int> columnOf, rowOf; // Grid line of each coordinate, -1 if there is none
+    std::vector<unsigned char> columnStarts, rowStarts; // Lines a rect corner may lie on
+    std::vector<unsigned char> cells;
+    int             columns = 0, rows = 0;
+
+    std::vector<ExactGroup> groups;
+    std::vector<ExactDecision> decisions;
+    std::vector<Rect> placed;
+    long long       freeArea = 0, remainingArea = 0;
+    int             remainingCount = 0;
+    long long       nodes = 0;
+};
+
+#endif // EXACT_PACKER_HPP
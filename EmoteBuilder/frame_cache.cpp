@@ -0,0 +1,347 @@
+#include <cstring>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSharedPointer>
+#include "frame_cache.hpp"
+#include "logger.hpp"
+
+// Cache files are only read on the machine that wrote them, so the header and records are stored as laid out in memory
+static const char cacheMagic[4] = { 'E', 'F', 'C', 'F' };
+static const quint32 cacheVersion = 2;
+static const int pixelAlignment = 16;
+
+class CacheFileHeader
+{
+public:
+    char            magic[4];
+    quint32         version;
+    qint64          sourceSize;
+    qint64          sourceModified; // ms since the epoch
+    char            contentHash[20];
+    quint32         frameCount;
+    qint64          recordsOffset; // Records follow the pixels, since they are only complete once the last frame is written
+};
+
+class CacheFrameRecord
+{
+public:
+    qint32          offsetX, offsetY;
+    qint32          width, height;
+    qint64          pixelOffset;
+    qint32          nameOffset, nameBytes;
+};
+
+// Unmaps a cache file once the last image served from it has been released
+class CacheMapping
+{
+public:
+    ~CacheMapping()
+    {
+        if (data)
+            file.unmap(data);
+    }
+
+    QFile           file;
+    uchar           *data;
+};
+
+static void releaseMapping(void *info)
+{
+    delete static_cast<QSharedPointer<CacheMapping> *>(info);
+}
+
+static qint64 alignUp(qint64 offset)
+{
+    return (offset + pixelAlignment - 1) / pixelAlignment * pixelAlignment;
+}
+
+FrameCache::FrameCache(const QString &directory, qint64 sizeLimit)
+{
+    this->directory = directory;
+    this->limit = sizeLimit;
+    QDir().mkpath(directory);
+}
+
+// Cache files are named after a hash of the absolute source path
+QString FrameCache::cachePath(const QString &path) const
+{
+    QByteArray key = QCryptographicHash::hash(QFileInfo(path).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+    return QDir(directory).filePath(QString::fromLatin1(key.toHex()) + ".frames");
+}
+
+QByteArray FrameCache::contentHash(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result();
+}
+
+/// Serves the frames of a source file from its cache file.
+/// @param frames [out] Receives the frames in source order, their images share the read-only mapping of the cache file.
+/// @return False on a miss, when the source changed or was never cached.
+bool FrameCache::lookup(const QString &path, QList<CachedFrame> &frames)
+{
+    frames.clear();
+    if (limit <= 0)
+        return false;
+
+    QFileInfo source(path);
+    QString cacheFile = cachePath(path);
+    QSharedPointer<CacheMapping> mapping(new CacheMapping());
+    mapping->file.setFileName(cacheFile);
+    mapping->data = nullptr;
+
+    auto miss = [this]()
+    {
+        QMutexLocker locker(&mutex);
+        misses++;
+        return false;
+    };
+
+    if (!mapping->file.open(QIODevice::ReadWrite))
+        return miss();
+
+    qint64 fileSize = mapping->file.size();
+    CacheFileHeader header;
+    if (fileSize < (qint64)sizeof(header) ||
+        mapping->file.read(reinterpret_cast<char *>(&header), sizeof(header)) != (qint64)sizeof(header) ||
+        memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion ||
+        header.sourceSize != source.size())
+    {
+        return miss();
+    }
+
+    // A new modification time alone doesn't invalidate the frames, only different content does
+    qint64 modified = source.lastModified().toMSecsSinceEpoch();
+    if (header.sourceModified != modified)
+    {
+        QByteArray hash = contentHash(path);
+        if (hash.size() != (int)sizeof(header.contentHash) || memcmp(hash.constData(), header.contentHash, sizeof(header.contentHash)) != 0)
+            return miss();
+
+        header.sourceModified = modified;
+        mapping->file.seek(0);
+        mapping->file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    // The modification time of the cache file is its last use, for eviction
+    mapping->file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    mapping->data = mapping->file.map(0, fileSize);
+    if (!mapping->data)
+        return miss();
+
+    qint64 recordsEnd = header.recordsOffset + (qint64)header.frameCount * sizeof(CacheFrameRecord);
+    if (header.recordsOffset < (qint64)sizeof(header) || header.recordsOffset % alignof(CacheFrameRecord) != 0 ||
+        recordsEnd > fileSize)
+    {
+        return miss();
+    }
+
+    const CacheFrameRecord *records = reinterpret_cast<const CacheFrameRecord *>(mapping->data + header.recordsOffset);
+    for (quint32 i = 0; i < header.frameCount; ++i)
+    {
+        const CacheFrameRecord &record = records[i];
+        qint64 pixelBytes = (qint64)record.width * record.height * 4;
+        if (record.width <= 0 || record.height <= 0 || record.pixelOffset < (qint64)sizeof(header) ||
+            record.pixelOffset + pixelBytes > header.recordsOffset ||
+            record.nameOffset < recordsEnd || (qint64)record.nameOffset + record.nameBytes > fileSize)
+        {
+            frames.clear();
+            return miss();
+        }
+
+        CachedFrame frame;
+        frame.name = QString::fromUtf8(reinterpret_cast<const char *>(mapping->data + record.nameOffset), record.nameBytes);
+        frame.offset = QPoint(record.offsetX, record.offsetY);
+        frame.image = QImage(static_cast<const uchar *>(mapping->data + record.pixelOffset), record.width, record.height,
+                             record.width * 4, QImage::Format_ARGB32, releaseMapping, new QSharedPointer<CacheMapping>(mapping));
+        frames.append(frame);
+    }
+
+    QMutexLocker locker(&mutex);
+    hits++;
+    mapped += fileSize;
+    usedFiles.insert(QFileInfo(cacheFile).fileName());
+    return true;
+}
+
+/// Starts the cache file of a source file, replacing an outdated one once finishStore commits it.
+/// @return False if the cache is disabled or the file can't be written, storeFrame and finishStore then do nothing.
+bool FrameCache::beginStore(const QString &path, CacheWriter &writer)
+{
+    writer = CacheWriter();
+    if (limit <= 0)
+        return false;
+
+    QFileInfo source(path);
+    writer.contentHash = contentHash(path);
+    if (writer.contentHash.size() != 20)
+        return false;
+
+    writer.path = path;
+    writer.sourceSize = source.size();
+    writer.sourceModified = source.lastModified().toMSecsSinceEpoch();
+
+    QString cacheFile = cachePath(path);
+    writer.file.reset(new QSaveFile(cacheFile));
+    if (!writer.file->open(QIODevice::WriteOnly))
+    {
+        Logger::write(QString("Could not write frame cache file %1: %2").arg(cacheFile).arg(writer.file->errorString()));
+        writer.file.reset();
+        return false;
+    }
+
+    // The header is rewritten with the frame count and records by finishStore
+    CacheFileHeader header = {};
+    writer.file->write(reinterpret_cast<const char *>(&header), sizeof(header));
+    return true;
+}
+
+/// Appends the pixels of the next trimmed frame of the source file, only its record is kept until the file is finished.
+void FrameCache::storeFrame(CacheWriter &writer, const CachedFrame &frame)
+{
+    if (!writer.file)
+        return;
+
+    const char padding[pixelAlignment] = {};
+    qint64 position = writer.file->pos();
+    writer.file->write(padding, alignUp(position) - position);
+
+    CacheFrameRecord record;
+    record.offsetX = frame.offset.x();
+    record.offsetY = frame.offset.y();
+    record.width = frame.image.width();
+    record.height = frame.image.height();
+    record.pixelOffset = writer.file->pos();
+    record.nameOffset = writer.names.size();
+
+    QByteArray name = frame.name.toUtf8();
+    record.nameBytes = name.size();
+    writer.names.append(name);
+    writer.records.append(reinterpret_cast<const char *>(&record), sizeof(record));
+
+    QImage image = frame.image.format() == QImage::Format_ARGB32 ? frame.image
+                                                                 : frame.image.convertToFormat(QImage::Format_ARGB32);
+    for (int y = 0; y < image.height(); ++y)
+        writer.file->write(reinterpret_cast<const char *>(image.constScanLine(y)), image.width() * 4);
+}
+
+/// Writes the records and names after the pixels, fills in the header and replaces the cache file.
+void FrameCache::finishStore(CacheWriter &writer)
+{
+    if (!writer.file)
+        return;
+
+    QSharedPointer<QSaveFile> file = writer.file;
+    writer.file.reset();
+
+    CacheFileHeader header;
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.sourceSize = writer.sourceSize;
+    header.sourceModified = writer.sourceModified;
+    memcpy(header.contentHash, writer.contentHash.constData(), sizeof(header.contentHash));
+    header.frameCount = writer.records.size() / sizeof(CacheFrameRecord);
+
+    const char padding[pixelAlignment] = {};
+    qint64 position = file->pos();
+    header.recordsOffset = alignUp(position);
+    file->write(padding, header.recordsOffset - position);
+
+    qint64 namesOffset = header.recordsOffset + writer.records.size();
+    CacheFrameRecord *records = reinterpret_cast<CacheFrameRecord *>(writer.records.data());
+    for (quint32 i = 0; i < header.frameCount; ++i)
+        records[i].nameOffset += (qint32)namesOffset;
+    file->write(writer.records);
+    file->write(writer.names);
+
+    file->seek(0);
+    file->write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    QString cacheFile = file->fileName();
+    if (!file->commit())
+    {
+        Logger::write(QString("Could not write frame cache file %1: %2").arg(cacheFile).arg(file->errorString()));
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    usedFiles.insert(QFileInfo(cacheFile).fileName());
+}
+
+/// Removes the least recently used cache files until the directory fits the size limit. Files used since the last
+/// eviction are kept even over the limit, since the frames of the current load may still be mapped from them.
+void FrameCache::evict()
+{
+    QMutexLocker locker(&mutex);
+
+    QFileInfoList files = QDir(directory).entryInfoList({ "*.frames" }, QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 total = 0;
+    for (const QFileInfo &file : files)
+        total += file.size();
+
+    int evicted = 0;
+    for (const QFileInfo &file : files)
+    {
+        if (total <= limit)
+            break;
+        if (usedFiles.contains(file.fileName()) || !QFile::remove(file.absoluteFilePath()))
+            continue;
+
+        total -= file.size();
+        evicted++;
+    }
+
+    if (evicted > 0)
+        Logger::write(QString("Evicted %1 frame cache files, %2 MB left").arg(evicted).arg(total / (1024 * 1024)));
+
+    usedFiles.clear();
+}
+
+// Caps the bytes of the cache directory, 0 disables the cache
+void FrameCache::setSizeLimit(qint64 bytes)
+{
+    limit = bytes;
+    evict();
+}
+
+qint64 FrameCache::sizeLimit() const
+{
+    return limit;
+}
+
+void FrameCache::resetStatistics()
+{
+    QMutexLocker locker(&mutex);
+    hits = 0;
+    misses = 0;
+    mapped = 0;
+}
+
+// Source files served from the cache since the statistics were reset
+int FrameCache::hitCount() const
+{
+    QMutexLocker locker(&mutex);
+    return hits;
+}
+
+int FrameCache::missCount() const
+{
+    QMutexLocker locker(&mutex);
+    return misses;
+}
+
+qint64 FrameCache::mappedBytes() const
+{
+    QMutexLocker locker(&mutex);
+    return mapped;
+}
@@ -0,0 +1,71 @@
+#ifndef FRAME_CACHE_HPP
+#define FRAME_CACHE_HPP
+
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QPoint>
+#include <QSaveFile>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+
+/// A decoded and trimmed frame of a source file, with the pixels cropped from the left and top by trimming.
+class CachedFrame
+{
+public:
+    QString         name;
+    QPoint          offset;
+    QImage          image;
+};
+
+/// A cache file being written one frame at a time, see FrameCache::beginStore.
+class CacheWriter
+{
+public:
+    QString         path; // Source file
+    QSharedPointer<QSaveFile> file; // Null when nothing is being written
+    qint64          sourceSize = 0;
+    qint64          sourceModified = 0;
+    QByteArray      contentHash;
+    QByteArray      records; // Frame records in file layout, name offsets relative to names
+    QByteArray      names;
+};
+
+/// Keeps the trimmed frames of every loaded file in a cache directory as raw ARGB32, one cache file per source file.
+/// A source file is recognized by its path, size and modification time, or by its content hash once its modification
+/// time changed, so touched but unchanged files still hit. Hits map the cache file and serve the frames from the mapping
+/// without decoding or trimming. Misses are written a frame at a time as the frames are stored, so a long animation is
+/// never held in memory for its cache file. The directory is kept under a size limit by removing the least recently used
+/// files. Lookups and stores may run on different threads.
+class FrameCache
+{
+public:
+    FrameCache(const QString &directory, qint64 sizeLimit);
+    bool lookup(const QString &path, QList<CachedFrame> &frames);
+    bool beginStore(const QString &path, CacheWriter &writer);
+    void storeFrame(CacheWriter &writer, const CachedFrame &frame);
+    void finishStore(CacheWriter &writer);
+    void evict();
+    void setSizeLimit(qint64 bytes);
+    qint64 sizeLimit() const;
+    void resetStatistics();
+    int hitCount() const;
+    int missCount() const;
+    qint64 mappedBytes() const;
+
+private:
+    QString cachePath(const QString &path) const;
+    static QByteArray contentHash(const QString &path);
+
+    QString         directory;
+    qint64          limit = 0;
+
+    mutable QMutex  mutex;
+    QSet<QString>   usedFiles; // Cache files served or written since the last eviction
+    int             hits = 0;
+    int             misses = 0;
+    qint64          mapped = 0;
+};
+
+#endif // FRAME_CACHE_HPP
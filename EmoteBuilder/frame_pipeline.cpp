@@ -0,0 +1,215 @@
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMap>
+#include <QScopedPointer>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "allocation_tracker.hpp"
+#include "bounded_queue.hpp"
+#include "frame_pipeline.hpp"
+#include "frame_source.hpp"
+#include "logger.hpp"
+
+// Crops the transparent border, offset receives the pixels cropped from the left and top
+QImage trimImage(QImage image, QPoint *offset)
+{
+    int width = image.width();
+    int height = image.height();
+    int top = height / 2;
+    int bottom = top;
+    int left = width / 2 ;
+    int right = left;
+    for (int x = 0; x < width; x++) {
+        for (int y = 0; y < height; y++) {
+            if (image.pixelColor(x, y).alpha() != 0){
+                top    = std::min(top, y);
+                bottom = std::max(bottom, y);
+                left   = std::min(left, x);
+                right  = std::max(right, x);
+            }
+        }
+    }
+
+    if (offset)
+        *offset = QPoint(left, top);
+    return image.copy(left, top, right - left + 1, bottom - top + 1);
+}
+
+FramePipeline::FramePipeline(int queueDepth, FrameCache *cache)
+{
+    this->queueDepth = queueDepth;
+    this->cache = cache;
+}
+
+/// Decodes, trims and stores the frames of every batch. Within a batch files are read in name order, so frame IDs
+/// follow animation order exactly as if the batches were loaded one file at a time.
+/// @return The number of frames each batch added to the store.
+QList<int> FramePipeline::load(const QList<FrameBatch> &batches, FrameStore &store)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    int trimWorkerCount = std::max(1, QThread::idealThreadCount() - 1);
+    BoundedQueue<PipelineFrame> decoded(queueDepth);
+    BoundedQueue<PipelineFrame> trimmed(queueDepth);
+    QAtomicInt runningTrimWorkers(trimWorkerCount);
+    qint64 decodeTime = 0;
+
+    // Caps the frames decoded but not yet stored, wherever they are: in a queue, with a worker or in the reorder buffer.
+    // A worker stalled on one frame then stops the decoder instead of letting every later frame pile up in the buffer.
+    QSemaphore framesInFlight(queueDepth * 2 + trimWorkerCount);
+
+    // The stages block on each other, so they get their own threads instead of competing for the global pool
+    QThreadPool stagePool;
+    stagePool.setMaxThreadCount(trimWorkerCount + 1);
+
+    if (cache)
+        cache->resetStatistics();
+
+    QFuture<void> decoder = QtConcurrent::run(&stagePool, [this, &batches, &decoded, &decodeTime, &framesInFlight]()
+    {
+        AllocationScope allocationScope("load: decode");
+        QElapsedTimer decodeTimer;
+        decodeTimer.start();
+
+        int sequence = 0;
+        for (int batch = 0; batch < batches.count(); ++batch)
+        {
+            QStringList paths = batches[batch].paths;
+            std::sort(paths.begin(), paths.end(), [](const QString &pathA, const QString &pathB)
+            {
+                return QFileInfo(pathA).baseName() < QFileInfo(pathB).baseName();
+            });
+
+            for (const QString &path : paths)
+            {
+                PipelineFrame frame;
+                frame.batch = batch;
+                frame.path = path;
+
+                QList<CachedFrame> cachedFrames;
+                if (cache && cache->lookup(path, cachedFrames))
+                {
+                    frame.cached = true;
+                    for (const CachedFrame &cachedFrame : cachedFrames)
+                    {
+                        frame.sequence = sequence++;
+                        frame.name = cachedFrame.name;
+                        frame.image = cachedFrame.image;
+                        frame.offset = cachedFrame.offset;
+                        framesInFlight.acquire();
+                        decoded.push(frame);
+                    }
+                    continue;
+                }
+
+                QScopedPointer<FrameSource> source(FrameSource::open(path));
+                while (source->readNext(frame.name, frame.image))
+                {
+                    frame.sequence = sequence++;
+                    framesInFlight.acquire();
+                    decoded.push(frame);
+                }
+            }
+        }
+
+        decoded.close();
+        decodeTime = decodeTimer.elapsed();
+    });
+
+    QList<QFuture<void>> trimWorkers;
+    for (int i = 0; i < trimWorkerCount; ++i)
+    {
+        trimWorkers.append(QtConcurrent::run(&stagePool, [&decoded, &trimmed, &runningTrimWorkers]()
+        {
+            AllocationScope allocationScope("load: trim");
+            PipelineFrame frame;
+            while (decoded.pop(frame))
+            {
+                if (!frame.cached)
+                    frame.image = trimImage(frame.image, &frame.offset);
+                trimmed.push(frame);
+            }
+
+            // The last worker to run out of input ends the stream
+            if (!runningTrimWorkers.deref())
+                trimmed.close();
+        }));
+    }
+
+    // Workers finish out of order, frames wait here until every earlier frame has been stored. Their slots in
+    // framesInFlight are only released once stored, so this never holds more frames than that allows.
+    QList<int> frameCounts;
+    for (int batch = 0; batch < batches.count(); ++batch)
+        frameCounts.append(0);
+
+    // Frames of a file that missed the cache are appended to its cache file as they are stored, the file is finished
+    // once the next file starts
+    QString currentPath;
+    CacheWriter cacheWriter;
+
+    AllocationScope allocationScope("load: frame store");
+    QMap<int, PipelineFrame> pending;
+    int nextSequence = 0;
+    PipelineFrame frame;
+    while (trimmed.pop(frame))
+    {
+        pending.insert(frame.sequence, frame);
+        while (pending.contains(nextSequence))
+        {
+            PipelineFrame next = pending.take(nextSequence++);
+            int countBefore = store.count();
+            store.insert(batches[next.batch].prefix + next.name, next.image);
+            frameCounts[next.batch] += store.count() - countBefore;
+            framesInFlight.release();
+
+            if (!cache)
+                continue;
+
+            AllocationScope cacheScope("load: frame cache");
+            if (next.path != currentPath)
+            {
+                cache->finishStore(cacheWriter);
+                currentPath = next.path;
+                if (!next.cached)
+                    cache->beginStore(currentPath, cacheWriter);
+            }
+
+            CachedFrame cachedFrame;
+            cachedFrame.name = next.name;
+            cachedFrame.offset = next.offset;
+            cachedFrame.image = next.image;
+            cache->storeFrame(cacheWriter, cachedFrame);
+        }
+    }
+    if (cache)
+        cache->finishStore(cacheWriter);
+
+    decoder.waitForFinished();
+    for (QFuture<void> &worker : trimWorkers)
+        worker.waitForFinished();
+
+    Logger::write(QString("Loaded %1 frames from %2 batches in %3 ms, decoding took %4 ms, %5 trim workers, queue depth %6")
+                  .arg(nextSequence)
+                  .arg(batches.count())
+                  .arg(timer.elapsed())
+                  .arg(decodeTime)
+                  .arg(trimWorkerCount)
+                  .arg(queueDepth));
+
+    if (cache)
+    {
+        int files = cache->hitCount() + cache->missCount();
+        Logger::write(QString("Frame cache hit %1 of %2 files (%3%), %4 MB mapped")
+                      .arg(cache->hitCount())
+                      .arg(files)
+                      .arg(files > 0 ? 100 * cache->hitCount() / files : 0)
+                      .arg(cache->mappedBytes() / (1024 * 1024)));
+        cache->evict();
+    }
+
+    return frameCounts;
+}
@@ -0,0 +1,51 @@
+#ifndef FRAME_PIPELINE_HPP
+#define FRAME_PIPELINE_HPP
+
+#include <QImage>
+#include <QList>
+#include <QPoint>
+#include <QString>
+#include <QStringList>
+#include "frame_cache.hpp"
+#include "frame_store.hpp"
+
+QImage trimImage(QImage image, QPoint *offset = nullptr);
+
+/// Frame files loaded as one unit, such as the frames of one emote. Frames are stored as prefix + source frame name.
+class FrameBatch
+{
+public:
+    QString         prefix;
+    QStringList     paths;
+};
+
+class PipelineFrame
+{
+public:
+    int             sequence;
+    int             batch;
+    QString         path;
+    QString         name;
+    QImage          image;
+    QPoint          offset;
+    bool            cached = false; // Served trimmed from the frame cache
+};
+
+/// Loads frames in three overlapping stages: one thread decodes the files of every batch in order, a pool of workers
+/// trims the decoded frames, and the calling thread stores them in decode order. The stages are connected by bounded
+/// queues and the decoder waits while two queue depths plus one frame per worker are not yet stored, so that many frames
+/// are held in memory besides the store itself, and the next batch is being decoded while the frames of the current one
+/// are trimmed.
+/// With a frame cache, files it holds skip decoding and trimming, and the frames of every other file are cached once stored.
+class FramePipeline
+{
+public:
+    FramePipeline(int queueDepth, FrameCache *cache = nullptr);
+    QList<int> load(const QList<FrameBatch> &batches, FrameStore &store);
+
+private:
+    int             queueDepth = 8;
+    FrameCache      *cache = nullptr;
+};
+
+#endif // FRAME_PIPELINE_HPP
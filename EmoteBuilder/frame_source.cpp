@@ -0,0 +1,161 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "frame_source.hpp"
+#include "logger.hpp"
+
+FrameSource::~FrameSource()
+{
+
+}
+
+// Picks a reader by file type: JSON files describe sprite sheets, anything else is read as a (possibly animated) image
+FrameSource *FrameSource::open(const QString &path)
+{
+    if (QFileInfo(path).suffix().toLower() == "json")
+        return new SpriteSheetSource(path);
+
+    return new ImageFileSource(path);
+}
+
+ImageFileSource::ImageFileSource(const QString &path) : reader(path)
+{
+    baseName = QFileInfo(path).baseName();
+    animated = reader.supportsAnimation() && reader.imageCount() != 1;
+}
+
+bool ImageFileSource::readNext(QString &name, QImage &frame)
+{
+    if (!reader.canRead())
+        return false;
+
+    frame = reader.read();
+    if (frame.isNull())
+    {
+        Logger::write("Failed to read frame " + QString::number(frameNumber) + " of " + baseName + ": " + reader.errorString());
+        return false;
+    }
+
+    frame = frame.convertToFormat(QImage::Format_ARGB32);
+    name = animated ? QString("%1_%2").arg(baseName).arg(frameNumber, 4, 10, QChar('0')) : baseName;
+    frameNumber++;
+    return true;
+}
+
+// The sheet image a description names, relative to its JSON file
+static QString sheetImageName(const QJsonObject &description)
+{
+    return description.contains("image") ? description["image"].toString()
+                                         : description["meta"].toObject()["image"].toString();
+}
+
+/// The sheet image of a description, so callers listing frame files can leave it to the description.
+/// @return An empty string if the description can't be read or names no image.
+QString SpriteSheetSource::imagePath(const QString &path)
+{
+    QFile jsonFile(path);
+    if (!jsonFile.open(QFile::ReadOnly))
+        return QString();
+
+    QString imageName = sheetImageName(QJsonDocument::fromJson(jsonFile.readAll()).object());
+    return imageName.isEmpty() ? QString() : QFileInfo(path).absolutePath() + "/" + imageName;
+}
+
+/// Sheet descriptions come in two forms, with "image" resolved relative to the JSON file:
+/// a grid, { "image": "sheet.png", "frameWidth": 64, "frameHeight": 64, "count": 10, "margin": 0, "spacing": 0 },
+/// or named rects in the common packer layout, { "meta": { "image": "sheet.png" }, "frames": [ { "filename": "a", "frame": { "x", "y", "w", "h" } } ] },
+/// where "frames" may also be an object keyed by frame name.
+SpriteSheetSource::SpriteSheetSource(const QString &path)
+{
+    QFile jsonFile(path);
+    if (!jsonFile.open(QFile::ReadOnly))
+    {
+        Logger::write("Failed to open sprite sheet description " + path);
+        return;
+    }
+
+    const QJsonObject description = QJsonDocument::fromJson(jsonFile.readAll()).object();
+    QString imageName = sheetImageName(description);
+    sheetPath = QFileInfo(path).absolutePath() + "/" + imageName;
+    QString baseName = QFileInfo(imageName).baseName();
+
+    if (description.contains("frameWidth"))
+    {
+        int frameWidth = description["frameWidth"].toInt();
+        int frameHeight = description["frameHeight"].toInt();
+        int margin = description["margin"].toInt(0);
+        int spacing = description["spacing"].toInt(0);
+        if (frameWidth <= 0 || frameHeight <= 0)
+            return;
+
+        QSize sheetSize = QImageReader(sheetPath).size();
+        int columns = description["columns"].toInt((sheetSize.width() - 2 * margin + spacing) / (frameWidth + spacing));
+        int rows = description["rows"].toInt((sheetSize.height() - 2 * margin + spacing) / (frameHeight + spacing));
+        int count = description["count"].toInt(columns * rows);
+
+        for (int i = 0; i < count && i < columns * rows; ++i)
+        {
+            int column = i % columns;
+            int row = i / columns;
+            rects.append(QRect(margin + column * (frameWidth + spacing), margin + row * (frameHeight + spacing), frameWidth, frameHeight));
+            names.append(QString("%1_%2").arg(baseName).arg(i, 4, 10, QChar('0')));
+        }
+    }
+    else if (description["frames"].isArray())
+    {
+        for (QJsonValue value : description["frames"].toArray())
+        {
+            QJsonObject frameObj = value.toObject();
+            QJsonObject rectObj = frameObj["frame"].toObject();
+            rects.append(QRect(rectObj["x"].toInt(), rectObj["y"].toInt(), rectObj["w"].toInt(), rectObj["h"].toInt()));
+            names.append(QFileInfo(frameObj["filename"].toString()).baseName());
+        }
+    }
+    else
+    {
+        QJsonObject framesObj = description["frames"].toObject();
+        for (QString key : framesObj.keys())
+        {
+            QJsonObject rectObj = framesObj[key].toObject()["frame"].toObject();
+            rects.append(QRect(rectObj["x"].toInt(), rectObj["y"].toInt(), rectObj["w"].toInt(), rectObj["h"].toInt()));
+            names.append(QFileInfo(key).baseName());
+        }
+    }
+}
+
+bool SpriteSheetSource::readNext(QString &name, QImage &frame)
+{
+    if (frameNumber >= rects.count())
+    {
+        sheet = QImage();
+        return false;
+    }
+
+    QImageReader reader(sheetPath);
+    if (reader.supportsOption(QImageIOHandler::ClipRect))
+    {
+        // The handler can decode just the requested region, so the sheet is never fully decoded
+        reader.setClipRect(rects[frameNumber]);
+        frame = reader.read();
+    }
+    else
+    {
+        // Formats such as PNG always decode whole, so decode the sheet once and cut frames from it
+        if (sheet.isNull())
+            sheet = reader.read();
+        frame = sheet.copy(rects[frameNumber]);
+    }
+
+    if (frame.isNull())
+    {
+        Logger::write("Failed to read frame " + names[frameNumber] + " from " + sheetPath);
+        return false;
+    }
+
+    frame = frame.convertToFormat(QImage::Format_ARGB32);
+    name = names[frameNumber];
+    frameNumber++;
+    return true;
+}
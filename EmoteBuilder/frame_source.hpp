@@ -0,0 +1,52 @@
+#ifndef FRAME_SOURCE_HPP
+#define FRAME_SOURCE_HPP
+
+#include <QImage>
+#include <QImageReader>
+#include <QList>
+#include <QRect>
+#include <QString>
+
+/// Decodes the frames of an emote one at a time, so a caller can trim and store each frame
+/// before the next one is decoded instead of holding the whole sequence in memory.
+class FrameSource
+{
+public:
+    virtual ~FrameSource();
+    virtual bool readNext(QString &name, QImage &frame) = 0;
+
+    static FrameSource *open(const QString &path);
+};
+
+/// Reads a single image, or every frame of an animated image (GIF, WebP, or APNG when an image format plugin provides it).
+class ImageFileSource : public FrameSource
+{
+public:
+    ImageFileSource(const QString &path);
+    bool readNext(QString &name, QImage &frame) override;
+
+private:
+    QImageReader    reader;
+    QString         baseName;
+    bool            animated = false;
+    int             frameNumber = 0;
+};
+
+/// Cuts frames out of a sprite sheet described by a JSON file, either as a regular grid or as a list of named rects.
+class SpriteSheetSource : public FrameSource
+{
+public:
+    SpriteSheetSource(const QString &path);
+    bool readNext(QString &name, QImage &frame) override;
+
+    static QString imagePath(const QString &path);
+
+private:
+    QString         sheetPath;
+    QImage          sheet;
+    QStringList     names;
+    QList<QRect>    rects;
+    int             frameNumber = 0;
+};
+
+#endif // FRAME_SOURCE_HPP
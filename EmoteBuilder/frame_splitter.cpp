@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <climits>
+#include "frame_splitter.hpp"
+
+// Extent of the visible pixels of one row or column of a piece, empty while min > max
+class PixelExtent
+{
+public:
+    int             min = INT_MAX, max = INT_MIN;
+};
+
+// Bounds of a run of rows or columns, from their extents along the other axis and their first and last visible index
+class RunBounds
+{
+public:
+    int             min = INT_MAX, max = INT_MIN;
+    int             first = -1, last = -1;
+
+    void add(int index, const PixelExtent &extent)
+    {
+        if (extent.min > extent.max)
+            return;
+        min = std::min(min, extent.min);
+        max = std::max(max, extent.max);
+        first = first == -1 ? index : std::min(first, index);
+        last = std::max(last, index);
+    }
+
+    long long area() const
+    {
+        return first == -1 ? 0 : (long long)(max - min + 1) * (last - first + 1);
+    }
+};
+
+FrameSplitter::FrameSplitter(int maxPieces)
+{
+    this->maxPieces = maxPieces;
+}
+
+static bool isVisible(const FramePixels &pixels, int x, int y)
+{
+    return (pixels.pixels[y * pixels.stride + x] >> 24) != 0;
+}
+
+/// Shrinks a piece to the bounds of its visible pixels.
+/// @return False if the piece has none.
+bool FrameSplitter::trim(const FramePixels &pixels, FramePiece &piece)
+{
+    int left = INT_MAX, right = INT_MIN, top = INT_MAX, bottom = INT_MIN;
+    for (int y = piece.y; y < piece.y + piece.height; ++y)
+    {
+        for (int x = piece.x; x < piece.x + piece.width; ++x)
+        {
+            if (!isVisible(pixels, x, y))
+                continue;
+            left = std::min(left, x);
+            right = std::max(right, x);
+            top = std::min(top, y);
+            bottom = std::max(bottom, y);
+        }
+    }
+
+    if (left > right)
+        return false;
+
+    piece.x = left;
+    piece.y = top;
+    piece.width = right - left + 1;
+    piece.height = bottom - top + 1;
+    return true;
+}
+
+/// Finds the row or column cut of a trimmed piece that leaves the least area once both halves are trimmed. The extents
+/// of every row and column are collected in one pass, then running bounds from both ends give the trimmed halves of
+/// every cut without rescanning pixels.
+/// @return The area saved by the best cut, 0 if no cut saves any.
+long long FrameSplitter::bestCut(const FramePixels &pixels, const FramePiece &piece, FramePiece &first, FramePiece &second) const
+{
+    std::vector<PixelExtent> rows(piece.height), columns(piece.width);
+    for (int y = 0; y < piece.height; ++y)
+    {
+        for (int x = 0; x < piece.width; ++x)
+        {
+            if (!isVisible(pixels, piece.x + x, piece.y + y))
+                continue;
+            rows[y].min = std::min(rows[y].min, x);
+            rows[y].max = std::max(rows[y].max, x);
+            columns[x].min = std::min(columns[x].min, y);
+            columns[x].max = std::max(columns[x].max, y);
+        }
+    }
+
+    long long pieceArea = (long long)piece.width * piece.height;
+    long long bestSaving = 0;
+    for (int horizontal = 0; horizontal < 2; ++horizontal)
+    {
+        const std::vector<PixelExtent> &lines = horizontal ? rows : columns;
+        int count = (int)lines.size();
+
+        // Bounds of the lines before each cut, and of the lines from each cut on
+        std::vector<RunBounds> before(count + 1), after(count + 1);
+        for (int i = 0; i < count; ++i)
+        {
+            before[i + 1] = before[i];
+            before[i + 1].add(i, lines[i]);
+        }
+        for (int i = count - 1; i >= 0; --i)
+        {
+            after[i] = after[i + 1];
+            after[i].add(i, lines[i]);
+        }
+
+        for (int cut = 1; cut < count; ++cut)
+        {
+            const RunBounds &head = before[cut];
+            const RunBounds &tail = after[cut];
+            if (head.first == -1 || tail.first == -1)
+                continue;
+
+            long long saving = pieceArea - head.area() - tail.area();
+            if (saving <= bestSaving)
+                continue;
+
+            // For rows the run gives y and the extents x, for columns the other way round
+            bestSaving = saving;
+            if (horizontal)
+            {
+                first = { piece.frame, piece.x + head.min, piece.y + head.first, head.max - head.min + 1, head.last - head.first + 1 };
+                second = { piece.frame, piece.x + tail.min, piece.y + tail.first, tail.max - tail.min + 1, tail.last - tail.first + 1 };
+            }
+            else
+            {
+                first = { piece.frame, piece.x + head.first, piece.y + head.min, head.last - head.first + 1, head.max - head.min + 1 };
+                second = { piece.frame, piece.x + tail.first, piece.y + tail.min, tail.last - tail.first + 1, tail.max - tail.min + 1 };
+            }
+        }
+    }
+
+    return bestSaving;
+}
+
+/// Appends the pieces of a frame. Frames that don't save enough area by splitting, or have no visible pixels, are
+/// appended whole as a single piece.
+/// @return The number of pieces appended.
+int FrameSplitter::split(int frame, const FramePixels &pixels, std::vector<FramePiece> &pieces) const
+{
+    FramePiece whole = { frame, 0, 0, pixels.width, pixels.height };
+    long long frameArea = (long long)pixels.width * pixels.height;
+
+    std::vector<FramePiece> parts;
+    FramePiece trimmed = whole;
+    if (maxPieces > 1 && trim(pixels, trimmed))
+        parts.push_back(trimmed);
+
+    long long saved = frameArea - (parts.empty() ? frameArea : (long long)trimmed.width * trimmed.height);
+    while (!parts.empty() && (int)parts.size() < maxPieces)
+    {
+        long long bestSaving = 0;
+        int bestPart = -1;
+        FramePiece bestFirst, bestSecond;
+        for (int i = 0; i < (int)parts.size(); ++i)
+        {
+            FramePiece first, second;
+            long long saving = bestCut(pixels, parts[i], first, second);
+            if (saving > bestSaving)
+            {
+                bestSaving = saving;
+                bestPart = i;
+                bestFirst = first;
+                bestSecond = second;
+            }
+        }
+
+        if (bestPart == -1 || bestSaving * minCutShare < frameArea)
+            break;
+
+        parts[bestPart] = bestFirst;
+        parts.push_back(bestSecond);
+        saved += bestSaving;
+    }
+
+    if (parts.size() < 2 || saved * minSplitShare < frameArea)
+    {
+        pieces.push_back(whole);
+        return 1;
+    }
+
+    pieces.insert(pieces.end(), parts.begin(), parts.end());
+    return (int)parts.size();
+}
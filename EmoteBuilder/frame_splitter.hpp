@@ -0,0 +1,35 @@
+#ifndef FRAME_SPLITTER_HPP
+#define FRAME_SPLITTER_HPP
+
+#include <vector>
+#include "atlas_renderer.hpp"
+
+/// A region of a frame that is packed as a rect of its own. Rows are counted from the top of the frame.
+class FramePiece
+{
+public:
+    int             frame;
+    int             x, y, width, height;
+};
+
+/// Cuts frames whose visible pixels leave large transparent parts of their bounding box, like L-shaped or spread out
+/// poses, into a few tight rects, the split regions of tk2d. Cuts are guillotine cuts along a row or a column, each
+/// trimming both halves to their visible pixels. The cut saving the most area is taken until the piece limit is reached
+/// or no cut saves enough to pay for the edges of another rect in the atlas.
+class FrameSplitter
+{
+public:
+    FrameSplitter(int maxPieces);
+    int split(int frame, const FramePixels &pixels, std::vector<FramePiece> &pieces) const;
+
+private:
+    long long bestCut(const FramePixels &pixels, const FramePiece &piece, FramePiece &first, FramePiece &second) const;
+    static bool trim(const FramePixels &pixels, FramePiece &piece);
+
+    int             maxPieces = 4;
+
+    static const int minCutShare = 16; // A cut must save 1/16 of the frame's area
+    static const int minSplitShare = 8; // The pieces together must save 1/8 of it
+};
+
+#endif // FRAME_SPLITTER_HPP
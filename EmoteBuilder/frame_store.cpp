@@ -0,0 +1,331 @@
+#include <QDir>
+#include <QMutex>
+#include "frame_store.hpp"
+#include "logger.hpp"
+
+// Keeps the spill file open until every image mapped from it has been released
+class SpillMapping
+{
+public:
+    QSharedPointer<SpillFile> spill;
+    uchar           *data;
+};
+
+static void releaseMapping(void *info)
+{
+    SpillMapping *mapping = static_cast<SpillMapping *>(info);
+    {
+        QMutexLocker locker(&mapping->spill->mutex);
+        mapping->spill->file.unmap(mapping->data);
+    }
+    delete mapping;
+}
+
+static qint64 imageBytes(const QImage &image)
+{
+    return (qint64)image.bytesPerLine() * image.height();
+}
+
+// Spilled rows are packed
+static qint64 spillBytes(const Frame &frame)
+{
+    return (qint64)frame.size.width() * 4 * frame.size.height();
+}
+
+// Sparse frames are only kept when they save at least a quarter of the dense pixels
+static bool keepsSparse(const SparseFrame &sparse, qint64 denseBytes)
+{
+    return (qint64)sparse.byteSize() * 4 <= denseBytes * 3;
+}
+
+FrameStore::~FrameStore()
+{
+    clear();
+}
+
+// Adds a frame and returns its ID, a frame with the same name is replaced in place and keeps its ID
+int FrameStore::insert(const QString &name, const QImage &image)
+{
+    QImage argb = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    FramePixels pixels;
+    pixels.pixels = reinterpret_cast<const uint32_t *>(argb.constBits());
+    pixels.width = argb.width();
+    pixels.height = argb.height();
+    pixels.stride = argb.bytesPerLine() / (int)sizeof(uint32_t);
+    QSharedPointer<const SparseFrame> sparse(new SparseFrame(SparseFrame::fromPixels(pixels)));
+    if (!keepsSparse(*sparse, imageBytes(argb)))
+        sparse.reset();
+
+    int id = ids.value(name, -1);
+    if (id != -1)
+    {
+        Frame &frame = frames[id];
+        if (frame.sparse)
+        {
+            resident -= frame.sparse->byteSize();
+            sparseResident -= frame.sparse->byteSize();
+        }
+        else if (!frame.image.isNull())
+        {
+            resident -= imageBytes(frame.image);
+            residentIds.removeOne(id);
+        }
+        else if (frame.spillOffset != -1)
+        {
+            spilled -= spillBytes(frame);
+            frame.spillOffset = -1;
+            compactSpillFile();
+        }
+        frame.size = argb.size();
+    }
+    else
+    {
+        Frame frame;
+        frame.id = frames.count();
+        frame.name = name;
+        frame.size = argb.size();
+        frames.append(frame);
+        ids.insert(name, frame.id);
+        id = frame.id;
+    }
+
+    Frame &frame = frames[id];
+    frame.sparse = sparse;
+    if (sparse)
+    {
+        frame.image = QImage();
+        resident += sparse->byteSize();
+        sparseResident += sparse->byteSize();
+        return id;
+    }
+
+    frame.image = argb;
+    resident += imageBytes(argb);
+    residentIds.append(id);
+    enforceBudget(id);
+    return id;
+}
+
+void FrameStore::clear()
+{
+    frames.clear();
+    ids.clear();
+    residentIds.clear();
+    resident = 0;
+    spilled = 0;
+    sparseResident = 0;
+
+    // Images still mapped from the old file keep it alive, the next spill starts a new one
+    spillFile.reset();
+}
+
+int FrameStore::count() const
+{
+    return frames.count();
+}
+
+bool FrameStore::isEmpty() const
+{
+    return frames.isEmpty();
+}
+
+// Returns -1 if no frame has the given name
+int FrameStore::idOf(const QString &name) const
+{
+    return ids.value(name, -1);
+}
+
+const QString &FrameStore::name(int id) const
+{
+    return frames.at(id).name;
+}
+
+/// Returns the frame, mapped back in from the spill file if it was evicted. The image shares its pixels with the store
+/// or the mapping, so it is cheap to return by value and stays valid after the store evicts or clears the frame.
+/// Sparse frames are expanded into a new image, callers that can draw spans should use sparseFrame instead.
+QImage FrameStore::image(int id) const
+{
+    const Frame &frame = frames.at(id);
+    if (frame.sparse)
+    {
+        QImage image(frame.size, QImage::Format_ARGB32);
+        image.fill(0);
+        frame.sparse->toPixels(reinterpret_cast<uint32_t *>(image.bits()), image.bytesPerLine() / (int)sizeof(uint32_t));
+        return image;
+    }
+    if (!frame.image.isNull() || frame.spillOffset == -1)
+        return frame.image;
+
+    int bytesPerLine = frame.size.width() * 4;
+    QMutexLocker locker(&spillFile->mutex);
+    uchar *data = spillFile->file.map(frame.spillOffset, (qint64)bytesPerLine * frame.size.height());
+    if (!data)
+    {
+        Logger::write(QString("Could not map spilled frame %1: %2").arg(frame.name).arg(spillFile->file.errorString()));
+        return QImage();
+    }
+
+    SpillMapping *mapping = new SpillMapping();
+    mapping->spill = spillFile;
+    mapping->data = data;
+    // Read-only pixels, an image that gets modified detaches from the mapping instead of writing to the spill file
+    return QImage(static_cast<const uchar *>(data), frame.size.width(), frame.size.height(), bytesPerLine,
+                  QImage::Format_ARGB32, releaseMapping, mapping);
+}
+
+// The runs of visible pixels of a mostly transparent frame, null for frames kept as images
+QSharedPointer<const SparseFrame> FrameStore::sparseFrame(int id) const
+{
+    return frames.at(id).sparse;
+}
+
+// The frame size without mapping a spilled frame
+QSize FrameStore::size(int id) const
+{
+    return frames.at(id).size;
+}
+
+// Caps the bytes of frames held in memory, 0 keeps every frame in memory
+void FrameStore::setMemoryBudget(qint64 bytes)
+{
+    memoryBudget = bytes;
+    if (!residentIds.isEmpty())
+        enforceBudget(residentIds.last());
+}
+
+qint64 FrameStore::residentBytes() const
+{
+    return resident;
+}
+
+qint64 FrameStore::spilledBytes() const
+{
+    return spilled;
+}
+
+qint64 FrameStore::sparseBytes() const
+{
+    return sparseResident;
+}
+
+// Spills the oldest resident frames until the budget holds, never the frame given, which the caller is about to use
+void FrameStore::enforceBudget(int keepId)
+{
+    if (memoryBudget <= 0)
+        return;
+
+    int i = 0;
+    while (resident > memoryBudget && i < residentIds.count())
+    {
+        int id = residentIds[i];
+        if (id == keepId || !spill(frames[id]))
+        {
+            ++i;
+            continue;
+        }
+
+        residentIds.removeAt(i);
+    }
+}
+
+static QSharedPointer<SpillFile> openSpillFile()
+{
+    QSharedPointer<SpillFile> spillFile(new SpillFile());
+    spillFile->file.setFileTemplate(QDir::temp().filePath("EmoteBuilder_frames_XXXXXX.raw"));
+    if (!spillFile->file.open())
+    {
+        Logger::write(QString("Could not create frame spill file: %1").arg(spillFile->file.errorString()));
+        return QSharedPointer<SpillFile>();
+    }
+    return spillFile;
+}
+
+bool FrameStore::spill(Frame &frame)
+{
+    if (!spillFile)
+        spillFile = openSpillFile();
+    if (!spillFile)
+        return false;
+
+    // Rows are written packed so a mapping of the frame's range is a valid ARGB32 image on its own
+    QMutexLocker locker(&spillFile->mutex);
+    QTemporaryFile &file = spillFile->file;
+    qint64 offset = file.size();
+    file.seek(offset);
+    int rowBytes = frame.size.width() * 4;
+    for (int y = 0; y < frame.size.height(); ++y)
+    {
+        if (file.write(reinterpret_cast<const char *>(frame.image.constScanLine(y)), rowBytes) != rowBytes)
+        {
+            Logger::write(QString("Could not spill frame %1: %2").arg(frame.name).arg(file.errorString()));
+            file.resize(offset);
+            return false;
+        }
+    }
+    file.flush();
+
+    resident -= imageBytes(frame.image);
+    spilled += spillBytes(frame);
+    frame.spillOffset = offset;
+    frame.image = QImage();
+    return true;
+}
+
+/// Moves the frames still spilled to a new spill file once replaced frames take up most of the old one, so rebuilding
+/// the same frames over and over doesn't grow it without bound. Ranges of the old file can't be reused or cut off in
+/// place, since images mapped from them may still be in use. Those keep the old file alive until they are released.
+void FrameStore::compactSpillFile()
+{
+    if (!spillFile)
+        return;
+    if (spilled == 0)
+    {
+        spillFile.reset();
+        return;
+    }
+
+    QSharedPointer<SpillFile> oldFile = spillFile;
+    {
+        QMutexLocker locker(&oldFile->mutex);
+        if (oldFile->file.size() <= spilled * 2)
+            return;
+    }
+
+    QSharedPointer<SpillFile> newFile = openSpillFile();
+    if (!newFile)
+        return;
+
+    // Offsets are only switched once every frame was copied, a failed copy leaves the old file in use
+    QList<qint64> offsets;
+    for (const Frame &frame : frames)
+    {
+        if (frame.spillOffset == -1)
+        {
+            offsets.append(-1);
+            continue;
+        }
+
+        QByteArray pixels;
+        {
+            QMutexLocker locker(&oldFile->mutex);
+            oldFile->file.seek(frame.spillOffset);
+            pixels = oldFile->file.read(spillBytes(frame));
+        }
+
+        QMutexLocker locker(&newFile->mutex);
+        qint64 offset = newFile->file.size();
+        newFile->file.seek(offset);
+        if (pixels.size() != spillBytes(frame) || newFile->file.write(pixels) != pixels.size())
+        {
+            Logger::write(QString("Could not compact frame spill file: %1").arg(newFile->file.errorString()));
+            return;
+        }
+        offsets.append(offset);
+    }
+    newFile->file.flush();
+
+    for (int id = 0; id < frames.count(); ++id)
+        frames[id].spillOffset = offsets[id];
+    spillFile = newFile;
+}
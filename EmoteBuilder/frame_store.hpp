@@ -0,0 +1,74 @@
+#ifndef FRAME_STORE_HPP
+#define FRAME_STORE_HPP
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include <QTemporaryFile>
+#include "sparse_frame.hpp"
+
+class Frame
+{
+public:
+    int             id;
+    QString         name;
+    QImage          image; // Null while the frame is spilled or sparse
+    QSharedPointer<const SparseFrame> sparse;
+    QSize           size;
+    qint64          spillOffset = -1;
+};
+
+// The spill file of a store and its lock. QFile is not thread safe, and spilled frames are mapped and released by the
+// threads rendering atlas bands. Images mapped from the file keep it alive after the store moved on to a new one.
+class SpillFile
+{
+public:
+    QTemporaryFile  file;
+    QMutex          mutex;
+};
+
+/// Owns the decoded frames of a build. Frames are addressed by an ID that is assigned on insertion
+/// and stays valid until the store is cleared, so the builder can look them up in constant time.
+/// With a memory budget, the oldest frames beyond it are spilled as raw ARGB32 to a temporary file and
+/// served from a memory mapping of that file afterwards, leaving their paging to the operating system.
+/// Frames that are mostly transparent are kept as runs of visible pixels instead, which takes less memory than spilling
+/// saves and lets the renderer draw them without touching their transparent pixels. These are never spilled.
+class FrameStore
+{
+public:
+    ~FrameStore();
+    int insert(const QString &name, const QImage &image);
+    void clear();
+    int count() const;
+    bool isEmpty() const;
+    int idOf(const QString &name) const;
+    const QString &name(int id) const;
+    QImage image(int id) const;
+    QSharedPointer<const SparseFrame> sparseFrame(int id) const;
+    QSize size(int id) const;
+    void setMemoryBudget(qint64 bytes);
+    qint64 residentBytes() const;
+    qint64 spilledBytes() const;
+    qint64 sparseBytes() const;
+
+private:
+    void enforceBudget(int keepId);
+    bool spill(Frame &frame);
+    void compactSpillFile();
+
+    QList<Frame>        frames;
+    QHash<QString, int> ids;
+    QList<int>          residentIds; // Resident frames, oldest first
+    qint64              memoryBudget = 0;
+    qint64              resident = 0;
+    qint64              spilled = 0;
+    qint64              sparseResident = 0; // Part of resident held by sparse frames
+
+    QSharedPointer<SpillFile> spillFile;
+};
+
+#endif // FRAME_STORE_HPP
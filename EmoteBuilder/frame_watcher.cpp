@@ -0,0 +1,125 @@
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include "frame_watcher.hpp"
+
+static const QStringList frameFilters = { "*.png", "*.gif", "*.apng", "*.webp", "*.json" };
+
+FrameWatcher::FrameWatcher(int debounceInterval, QObject *parent) : QObject(parent)
+{
+    debounceTimer.setSingleShot(true);
+    debounceTimer.setInterval(debounceInterval);
+
+    connect(&debounceTimer, &QTimer::timeout, this, &FrameWatcher::scan);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &FrameWatcher::scheduleScan);
+    connect(&watcher, &QFileSystemWatcher::directoryChanged, this, &FrameWatcher::scheduleScan);
+}
+
+// Starts watching the frame files of a directory. Ignored paths, such as build output, never trigger a change.
+void FrameWatcher::start(const QString &directory, const QStringList &ignoredPaths)
+{
+    stop();
+
+    this->directory = directory;
+    this->ignoredPaths.clear();
+    for (const QString &path : ignoredPaths)
+        this->ignoredPaths.insert(QFileInfo(path).absoluteFilePath());
+
+    files = listFrames();
+    watcher.addPath(directory);
+    if (!files.isEmpty())
+        watcher.addPaths(files.keys());
+}
+
+void FrameWatcher::stop()
+{
+    debounceTimer.stop();
+    if (!watcher.files().isEmpty())
+        watcher.removePaths(watcher.files());
+    if (!watcher.directories().isEmpty())
+        watcher.removePaths(watcher.directories());
+    directory.clear();
+    files.clear();
+}
+
+bool FrameWatcher::isWatching() const
+{
+    return !directory.isEmpty();
+}
+
+// Frame files found by the last scan, in no particular order
+QStringList FrameWatcher::framePaths() const
+{
+    return files.keys();
+}
+
+// Every notification of a burst pushes the scan back, so it runs once the files have been quiet for the interval
+void FrameWatcher::scheduleScan()
+{
+    debounceTimer.start();
+}
+
+QHash<QString, WatchedFile> FrameWatcher::listFrames() const
+{
+    QHash<QString, WatchedFile> found;
+    for (const QFileInfo &fileInfo : QDir(directory).entryInfoList(frameFilters, QDir::Files))
+    {
+        // A data.json describes a build, not a sprite sheet
+        if (fileInfo.fileName() == "data.json" || ignoredPaths.contains(fileInfo.absoluteFilePath()))
+            continue;
+
+        WatchedFile file;
+        file.size = fileInfo.size();
+        file.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+        found.insert(fileInfo.absoluteFilePath(), file);
+    }
+
+    return found;
+}
+
+void FrameWatcher::scan()
+{
+    if (!isWatching())
+        return;
+
+    QHash<QString, WatchedFile> current = listFrames();
+    QStringList changedPaths;
+    bool filesAddedOrRemoved = false;
+    qint64 savedAt = 0;
+    for (auto it = current.constBegin(); it != current.constEnd(); ++it)
+    {
+        auto previous = files.constFind(it.key());
+        if (previous == files.constEnd())
+            filesAddedOrRemoved = true;
+        else if (previous->size == it->size && previous->modified == it->modified)
+            continue;
+
+        changedPaths.append(it.key());
+        savedAt = std::max(savedAt, it->modified);
+    }
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it)
+    {
+        if (!current.contains(it.key()))
+            filesAddedOrRemoved = true;
+    }
+
+    files = current;
+
+    // Files replaced through a rename drop out of the watcher, so every scan watches the current set again
+    QStringList watched = watcher.files();
+    QStringList unwatched;
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it)
+    {
+        if (!watched.contains(it.key()))
+            unwatched.append(it.key());
+    }
+    if (!unwatched.isEmpty())
+        watcher.addPaths(unwatched);
+
+    if (changedPaths.isEmpty() && !filesAddedOrRemoved)
+        return;
+
+    if (savedAt == 0)
+        savedAt = QDateTime::currentMSecsSinceEpoch();
+    emit framesChanged(changedPaths, filesAddedOrRemoved, savedAt);
+}
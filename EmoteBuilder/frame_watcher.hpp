@@ -0,0 +1,49 @@
+#ifndef FRAME_WATCHER_HPP
+#define FRAME_WATCHER_HPP
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+// Size and modification time of a watched frame file, a change in either counts as a new version
+class WatchedFile
+{
+public:
+    qint64          size;
+    qint64          modified;
+};
+
+/// Watches the frame files of one directory and reports changes once a burst of them has settled. Exporters often
+/// write a file in several steps or replace it through a rename, so every notification restarts a short timer and
+/// only the rescan after it decides what changed, by comparing sizes and modification times with the previous scan.
+class FrameWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    FrameWatcher(int debounceInterval, QObject *parent = nullptr);
+    void start(const QString &directory, const QStringList &ignoredPaths);
+    void stop();
+    bool isWatching() const;
+    QStringList framePaths() const;
+
+signals:
+    /// changedPaths lists modified and added files. savedAt is the latest modification time among them, in ms since the epoch.
+    void framesChanged(const QStringList &changedPaths, bool filesAddedOrRemoved, qint64 savedAt);
+
+private:
+    void scheduleScan();
+    void scan();
+    QHash<QString, WatchedFile> listFrames() const;
+
+    QFileSystemWatcher watcher;
+    QTimer          debounceTimer;
+    QString         directory;
+    QSet<QString>   ignoredPaths;
+    QHash<QString, WatchedFile> files;
+};
+
+#endif // FRAME_WATCHER_HPP
@@ -0,0 +1,48 @@
+// Compiled with AVX2 enabled, only called after the CPU has been checked for AVX2 support
+#include "free_rect_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+
+namespace
+{
+class Avx2
+{
+public:
+    typedef __m256i Vec;
+    static const int lanes = 8;
+
+    static inline Vec set1(int value) { return _mm256_set1_epi32(value); }
+    static inline Vec laneIndex() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+    static inline Vec load(const int *source) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source)); }
+    static inline void store(int *destination, Vec value) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination), value); }
+    static inline Vec add(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+    static inline Vec sub(Vec a, Vec b) { return _mm256_sub_epi32(a, b); }
+    static inline Vec mul(Vec a, Vec b) { return _mm256_mullo_epi32(a, b); }
+    static inline Vec min(Vec a, Vec b) { return _mm256_min_epi32(a, b); }
+    static inline Vec max(Vec a, Vec b) { return _mm256_max_epi32(a, b); }
+    static inline Vec greater(Vec a, Vec b) { return _mm256_cmpgt_epi32(a, b); }
+    static inline Vec equal(Vec a, Vec b) { return _mm256_cmpeq_epi32(a, b); }
+    static inline Vec bitAnd(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+    static inline Vec bitOr(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+    static inline Vec select(Vec mask, Vec a, Vec b) { return _mm256_blendv_epi8(b, a, mask); }
+    static inline int mask(Vec value) { return _mm256_movemask_ps(_mm256_castsi256_ps(value)); }
+};
+}
+
+ScoreKernel scoreKernelAvx2(KernelScore score, bool allowRotation)
+{
+    return selectScoreKernel<Avx2>(score, allowRotation);
+}
+
+int fitFreeRectsAvx2(const int *width, const int *height, int count, int rectWidth, int rectHeight, unsigned char *fits)
+{
+    return fitFreeRects<Avx2>(width, height, count, rectWidth, rectHeight, fits);
+}
+
+int containFreeRectsAvx2(const int *x, const int *y, const int *width, const int *height, int begin, int count,
+                         int rectX, int rectY, int rectWidth, int rectHeight, unsigned char *flags)
+{
+    return containFreeRects<Avx2>(x, y, width, height, begin, count, rectX, rectY, rectWidth, rectHeight, flags);
+}
+#endif
@@ -0,0 +1,200 @@
+#ifndef FREE_RECT_KERNELS_HPP
+#define FREE_RECT_KERNELS_HPP
+
+#include <climits>
+
+// This header is shared with the SIMD translation units, which are compiled with extra instruction set flags.
+// It must stay free of Qt and standard library templates so that no inline code compiled for AVX2 can be picked
+// by the linker for the generic build.
+
+/// The placement scores a vectorized kernel can compute, as (primary, secondary) pairs where lower is better.
+enum KernelScore
+{
+    ScoreBottomLeft, /// (top side y, x)
+    ScoreShortSide, /// (short leftover side, long leftover side)
+    ScoreLongSide, /// (long leftover side, short leftover side)
+    ScoreArea /// (leftover area, short leftover side)
+};
+
+static const int maxSimdLanes = 8;
+
+/// The best candidate seen by each SIMD lane. Candidates are encoded as 2 * free rect index + 1 if rotated,
+/// so comparing (score1, score2, candidate) orders them exactly as a sequential scan would.
+class LaneScores
+{
+public:
+    int             score1[maxSimdLanes];
+    int             score2[maxSimdLanes];
+    int             candidate[maxSimdLanes];
+    int             laneCount;
+};
+
+/// A score kernel specialized for one placement score and rotation mode, see scoreFreeRects.
+typedef int (*ScoreKernel)(const int *x, const int *y, const int *width, const int *height, int count,
+                           int rectWidth, int rectHeight, LaneScores &lanes);
+
+ScoreKernel scoreKernelAvx2(KernelScore score, bool allowRotation);
+ScoreKernel scoreKernelSse41(KernelScore score, bool allowRotation);
+int fitFreeRectsAvx2(const int *width, const int *height, int count, int rectWidth, int rectHeight, unsigned char *fits);
+int fitFreeRectsSse41(const int *width, const int *height, int count, int rectWidth, int rectHeight, unsigned char *fits);
+int containFreeRectsAvx2(const int *x, const int *y, const int *width, const int *height, int begin, int count,
+                         int rectX, int rectY, int rectWidth, int rectHeight, unsigned char *flags);
+int containFreeRectsSse41(const int *x, const int *y, const int *width, const int *height, int begin, int count,
+                          int rectX, int rectY, int rectWidth, int rectHeight, unsigned char *flags);
+
+/// Scores whole blocks of free rects, V supplies the vector type and operations of one instruction set.
+/// The score and rotation mode are template parameters so the block loop carries no configuration branches.
+/// @return The number of free rects processed, always a multiple of the lane count. The caller handles the rest.
+template <class V, KernelScore Score, bool AllowRotation>
+int scoreFreeRects(const int *x, const int *y, const int *width, const int *height, int count,
+                   int rectWidth, int rectHeight, LaneScores &lanes)
+{
+    typedef typename V::Vec Vec;
+
+    int blockCount = count - count % V::lanes;
+    Vec best1 = V::set1(INT_MAX);
+    Vec best2 = V::set1(INT_MAX);
+    Vec bestCandidate = V::set1(-1);
+    Vec laneIndex = V::laneIndex();
+    Vec rectArea = V::set1(rectWidth * rectHeight);
+
+    for (int i = 0; i < blockCount; i += V::lanes)
+    {
+        Vec freeX = V::load(x + i);
+        Vec freeY = V::load(y + i);
+        Vec freeWidth = V::load(width + i);
+        Vec freeHeight = V::load(height + i);
+        Vec index = V::add(V::set1(i), laneIndex);
+
+        for (int rotated = 0; rotated <= (AllowRotation ? 1 : 0); ++rotated)
+        {
+            int placedWidth = rotated ? rectHeight : rectWidth;
+            int placedHeight = rotated ? rectWidth : rectHeight;
+            Vec fits = V::bitAnd(V::greater(freeWidth, V::set1(placedWidth - 1)),
+                                 V::greater(freeHeight, V::set1(placedHeight - 1)));
+
+            Vec leftoverHoriz = V::sub(freeWidth, V::set1(placedWidth));
+            Vec leftoverVert = V::sub(freeHeight, V::set1(placedHeight));
+            Vec score1, score2;
+            if constexpr (Score == ScoreBottomLeft)
+            {
+                score1 = V::add(freeY, V::set1(placedHeight));
+                score2 = freeX;
+            }
+            else if constexpr (Score == ScoreShortSide)
+            {
+                score1 = V::min(leftoverHoriz, leftoverVert);
+                score2 = V::max(leftoverHoriz, leftoverVert);
+            }
+            else if constexpr (Score == ScoreLongSide)
+            {
+                score1 = V::max(leftoverHoriz, leftoverVert);
+                score2 = V::min(leftoverHoriz, leftoverVert);
+            }
+            else
+            {
+                score1 = V::sub(V::mul(freeWidth, freeHeight), rectArea);
+                score2 = V::min(leftoverHoriz, leftoverVert);
+            }
+
+            // Strictly better only, so every lane keeps its earliest candidate among ties
+            Vec better = V::bitOr(V::greater(best1, score1),
+                                  V::bitAnd(V::equal(best1, score1), V::greater(best2, score2)));
+            Vec update = V::bitAnd(fits, better);
+            best1 = V::select(update, score1, best1);
+            best2 = V::select(update, score2, best2);
+            bestCandidate = V::select(update, V::add(V::add(index, index), V::set1(rotated)), bestCandidate);
+        }
+    }
+
+    V::store(lanes.score1, best1);
+    V::store(lanes.score2, best2);
+    V::store(lanes.candidate, bestCandidate);
+    lanes.laneCount = V::lanes;
+    return blockCount;
+}
+
+/// Picks the scoreFreeRects instantiation for a score and rotation mode, once per pack rather than per call.
+template <class V>
+ScoreKernel selectScoreKernel(KernelScore score, bool allowRotation)
+{
+    switch (score)
+    {
+        case ScoreBottomLeft:
+            return allowRotation ? &scoreFreeRects<V, ScoreBottomLeft, true> : &scoreFreeRects<V, ScoreBottomLeft, false>;
+        case ScoreShortSide:
+            return allowRotation ? &scoreFreeRects<V, ScoreShortSide, true> : &scoreFreeRects<V, ScoreShortSide, false>;
+        case ScoreLongSide:
+            return allowRotation ? &scoreFreeRects<V, ScoreLongSide, true> : &scoreFreeRects<V, ScoreLongSide, false>;
+        case ScoreArea:
+        default:
+            return allowRotation ? &scoreFreeRects<V, ScoreArea, true> : &scoreFreeRects<V, ScoreArea, false>;
+    }
+}
+
+/// Tests whole blocks of free rects for fit, writing bit 0 for upright and bit 1 for rotated placement into fits.
+/// @return The number of free rects processed, always a multiple of the lane count.
+template <class V>
+int fitFreeRects(const int *width, const int *height, int count, int rectWidth, int rectHeight, unsigned char *fits)
+{
+    typedef typename V::Vec Vec;
+
+    int blockCount = count - count % V::lanes;
+    Vec widthLimit = V::set1(rectWidth - 1);
+    Vec heightLimit = V::set1(rectHeight - 1);
+
+    for (int i = 0; i < blockCount; i += V::lanes)
+    {
+        Vec freeWidth = V::load(width + i);
+        Vec freeHeight = V::load(height + i);
+        int upright = V::mask(V::bitAnd(V::greater(freeWidth, widthLimit), V::greater(freeHeight, heightLimit)));
+        int rotated = V::mask(V::bitAnd(V::greater(freeWidth, heightLimit), V::greater(freeHeight, widthLimit)));
+        for (int lane = 0; lane < V::lanes; ++lane)
+            fits[i + lane] = (unsigned char)(((upright >> lane) & 1) | (((rotated >> lane) & 1) << 1));
+    }
+
+    return blockCount;
+}
+
+/// Tests whole blocks of free rects from begin on for containment against the given rect, writing bit 0 if the rect
+/// lies inside the free rect and bit 1 if the free rect lies inside the rect. Stops after the first block where the rect
+/// lies inside a free rect, since pruning removes it at that point.
+/// @return The index one past the last free rect processed.
+template <class V>
+int containFreeRects(const int *x, const int *y, const int *width, const int *height, int begin, int count,
+                     int rectX, int rectY, int rectWidth, int rectHeight, unsigned char *flags)
+{
+    typedef typename V::Vec Vec;
+
+    int end = begin + (count - begin) - (count - begin) % V::lanes;
+    Vec left = V::set1(rectX);
+    Vec top = V::set1(rectY);
+    Vec right = V::set1(rectX + rectWidth);
+    Vec bottom = V::set1(rectY + rectHeight);
+
+    for (int j = begin; j < end; j += V::lanes)
+    {
+        Vec freeLeft = V::load(x + j);
+        Vec freeTop = V::load(y + j);
+        Vec freeRight = V::add(freeLeft, V::load(width + j));
+        Vec freeBottom = V::add(freeTop, V::load(height + j));
+
+        // a >= b is computed as !(b > a)
+        int outside = V::mask(V::bitOr(V::bitOr(V::greater(freeLeft, left), V::greater(freeTop, top)),
+                                       V::bitOr(V::greater(right, freeRight), V::greater(bottom, freeBottom))));
+        int notInside = V::mask(V::bitOr(V::bitOr(V::greater(left, freeLeft), V::greater(top, freeTop)),
+                                         V::bitOr(V::greater(freeRight, right), V::greater(freeBottom, bottom))));
+        int fullMask = (1 << V::lanes) - 1;
+        int inside = ~outside & fullMask;
+        int contains = ~notInside & fullMask;
+        for (int lane = 0; lane < V::lanes; ++lane)
+            flags[j + lane] = (unsigned char)(((inside >> lane) & 1) | (((contains >> lane) & 1) << 1));
+
+        if (inside != 0)
+            return j + V::lanes;
+    }
+
+    return end;
+}
+
+#endif // FREE_RECT_KERNELS_HPP
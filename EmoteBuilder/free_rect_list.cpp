@@ -0,0 +1,293 @@
+#include "free_rect_list.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FREE_RECT_SIMD
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+static SimdLevel detectSimdLevel()
+{
+#if defined(FREE_RECT_SIMD) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osSavesAvx)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    if (avx2) return SimdAvx2;
+    if (sse41) return SimdSse41;
+#elif defined(FREE_RECT_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdAvx2;
+    if (__builtin_cpu_supports("sse4.1")) return SimdSse41;
+#endif
+    return SimdScalar;
+}
+
+SimdLevel FreeRectList::simdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+/// Returns the vectorized score kernel for this CPU, or null if free rects are scored with the scalar loop only.
+ScoreKernel FreeRectList::scoreKernel(KernelScore score, bool allowRotation)
+{
+#ifdef FREE_RECT_SIMD
+    switch (simdLevel())
+    {
+        case SimdAvx2: return scoreKernelAvx2(score, allowRotation);
+        case SimdSse41: return scoreKernelSse41(score, allowRotation);
+        case SimdScalar: break;
+    }
+#else
+    (void)score;
+    (void)allowRotation;
+#endif
+    return nullptr;
+}
+
+void FreeRectList::append(const Rect &rect)
+{
+    x.push_back(rect.x);
+    y.push_back(rect.y);
+    width.push_back(rect.width);
+    height.push_back(rect.height);
+}
+
+// Keeps the order of the remaining rects, placement ties are broken by it
+void FreeRectList::removeAt(int i)
+{
+    x.erase(x.begin() + i);
+    y.erase(y.begin() + i);
+    width.erase(width.begin() + i);
+    height.erase(height.begin() + i);
+}
+
+void FreeRectList::clear()
+{
+    x.clear();
+    y.clear();
+    width.clear();
+    height.clear();
+}
+
+/// Finds the free rect that gives the lowest (score1, score2) pair for the given rect, trying the upright placement
+/// before the rotated one and earlier free rects before later ones on ties, exactly like a sequential scan.
+/// @param kernel The vectorized kernel from scoreKernel for the same score and rotation mode, or null.
+/// @return The placed rect, or a zero-sized rect if it fits nowhere, in which case both scores are INT_MAX.
+template <KernelScore Score, bool AllowRotation>
+Rect FreeRectList::findBest(ScoreKernel kernel, int width, int height, int &score1, int &score2) const
+{
+    int count = this->count();
+    int bestScore1 = INT_MAX;
+    int bestScore2 = INT_MAX;
+    int bestCandidate = -1;
+    int processed = 0;
+
+    LaneScores lanes;
+    lanes.laneCount = 0;
+    if (kernel)
+        processed = kernel(x.data(), y.data(), this->width.data(), this->height.data(), count, width, height, lanes);
+
+    for (int lane = 0; lane < lanes.laneCount; ++lane)
+    {
+        if (lanes.candidate[lane] == -1)
+            continue;
+
+        if (lanes.score1[lane] < bestScore1 ||
+            (lanes.score1[lane] == bestScore1 && lanes.score2[lane] < bestScore2) ||
+            (lanes.score1[lane] == bestScore1 && lanes.score2[lane] == bestScore2 && lanes.candidate[lane] < bestCandidate))
+        {
+            bestScore1 = lanes.score1[lane];
+            bestScore2 = lanes.score2[lane];
+            bestCandidate = lanes.candidate[lane];
+        }
+    }
+
+    // Remaining rects that don't fill a whole vector, or all of them without SIMD
+    for (int i = processed; i < count; ++i)
+    {
+        for (int rotated = 0; rotated <= (AllowRotation ? 1 : 0); ++rotated)
+        {
+            int placedWidth = rotated ? height : width;
+            int placedHeight = rotated ? width : height;
+            if (this->width[i] < placedWidth || this->height[i] < placedHeight)
+                continue;
+
+            int leftoverHoriz = this->width[i] - placedWidth;
+            int leftoverVert = this->height[i] - placedHeight;
+            int candidateScore1, candidateScore2;
+            if constexpr (Score == ScoreBottomLeft)
+            {
+                candidateScore1 = y[i] + placedHeight;
+                candidateScore2 = x[i];
+            }
+            else if constexpr (Score == ScoreShortSide)
+            {
+                candidateScore1 = std::min(leftoverHoriz, leftoverVert);
+                candidateScore2 = std::max(leftoverHoriz, leftoverVert);
+            }
+            else if constexpr (Score == ScoreLongSide)
+            {
+                candidateScore1 = std::max(leftoverHoriz, leftoverVert);
+                candidateScore2 = std::min(leftoverHoriz, leftoverVert);
+            }
+            else
+            {
+                candidateScore1 = this->width[i] * this->height[i] - width * height;
+                candidateScore2 = std::min(leftoverHoriz, leftoverVert);
+            }
+
+            if (candidateScore1 < bestScore1 || (candidateScore1 == bestScore1 && candidateScore2 < bestScore2))
+            {
+                bestScore1 = candidateScore1;
+                bestScore2 = candidateScore2;
+                bestCandidate = i * 2 + rotated;
+            }
+        }
+    }
+
+    Rect bestNode = Rect();
+    score1 = bestScore1;
+    score2 = bestScore2;
+    if (bestCandidate == -1)
+        return bestNode;
+
+    int index = bestCandidate / 2;
+    bool rotated = (bestCandidate & 1) != 0;
+    bestNode.x = x[index];
+    bestNode.y = y[index];
+    bestNode.width = rotated ? height : width;
+    bestNode.height = rotated ? width : height;
+    return bestNode;
+}
+
+template Rect FreeRectList::findBest<ScoreBottomLeft, false>(ScoreKernel, int, int, int &, int &) const;
+template Rect FreeRectList::findBest<ScoreBottomLeft, true>(ScoreKernel, int, int, int &, int &) const;
+template Rect FreeRectList::findBest<ScoreShortSide, false>(ScoreKernel, int, int, int &, int &) const;
+template Rect FreeRectList::findBest<ScoreShortSide, true>(ScoreKernel, int, int, int &, int &) const;
+template Rect FreeRectList::findBest<ScoreLongSide, false>(ScoreKernel, int, int, int &, int &) const;
+template Rect FreeRectList::findBest<ScoreLongSide, true>(ScoreKernel, int, int, int &, int &) const;
+template Rect FreeRectList::findBest<ScoreArea, false>(ScoreKernel, int, int, int &, int &) const;
+template Rect FreeRectList::findBest<ScoreArea, true>(ScoreKernel, int, int, int &, int &) const;
+
+/// Tests every free rect for fit, writing bit 0 for upright and bit 1 for rotated placement.
+void FreeRectList::findFits(int width, int height, std::vector<unsigned char> &fits) const
+{
+    int count = this->count();
+    fits.resize(count);
+
+    int processed = 0;
+#ifdef FREE_RECT_SIMD
+    switch (simdLevel())
+    {
+        case SimdAvx2:
+            processed = fitFreeRectsAvx2(this->width.data(), this->height.data(), count, width, height, fits.data());
+            break;
+        case SimdSse41:
+            processed = fitFreeRectsSse41(this->width.data(), this->height.data(), count, width, height, fits.data());
+            break;
+        case SimdScalar:
+            break;
+    }
+#endif
+
+    for (int i = processed; i < count; ++i)
+    {
+        bool upright = this->width[i] >= width && this->height[i] >= height;
+        bool rotated = this->width[i] >= height && this->height[i] >= width;
+        fits[i] = (unsigned char)((upright ? 1 : 0) | (rotated ? 2 : 0));
+    }
+}
+
+/// Removes every free rect that is contained in another one. Equivalent to testing each pair in order and removing
+/// the contained rect right away, but the tests run vectorized and removals are compacted once per rect.
+void FreeRectList::pruneContained()
+{
+    for (int i = 0; i < count(); ++i)
+    {
+        int count = this->count();
+        flags.resize(count);
+
+        int processed = i + 1;
+#ifdef FREE_RECT_SIMD
+        switch (simdLevel())
+        {
+            case SimdAvx2:
+                processed = containFreeRectsAvx2(x.data(), y.data(), width.data(), height.data(), i + 1, count,
+                                                 x[i], y[i], width[i], height[i], flags.data());
+                break;
+            case SimdSse41:
+                processed = containFreeRectsSse41(x.data(), y.data(), width.data(), height.data(), i + 1, count,
+                                                  x[i], y[i], width[i], height[i], flags.data());
+                break;
+            case SimdScalar:
+                break;
+        }
+#endif
+
+        // Rect i is removed at the first free rect that contains it, rects it contains before that point go with it
+        int containedBy = -1;
+        for (int j = i + 1; j < processed; ++j)
+        {
+            if (flags[j] & 1)
+            {
+                containedBy = j;
+                break;
+            }
+        }
+
+        if (containedBy == -1)
+        {
+            for (int j = processed; j < count; ++j)
+            {
+                bool inside = x[i] >= x[j] && y[i] >= y[j] &&
+                              x[i] + width[i] <= x[j] + width[j] && y[i] + height[i] <= y[j] + height[j];
+                bool contains = x[j] >= x[i] && y[j] >= y[i] &&
+                                x[j] + width[j] <= x[i] + width[i] && y[j] + height[j] <= y[i] + height[i];
+                flags[j] = (unsigned char)((inside ? 1 : 0) | (contains ? 2 : 0));
+                if (inside)
+                {
+                    containedBy = j;
+                    break;
+                }
+            }
+        }
+
+        int last = containedBy == -1 ? count : containedBy;
+        int kept = i + 1;
+        for (int j = i + 1; j < count; ++j)
+        {
+            if (j < last && (flags[j] & 2))
+                continue;
+
+            x[kept] = x[j];
+            y[kept] = y[j];
+            width[kept] = width[j];
+            height[kept] = height[j];
+            kept++;
+        }
+
+        x.resize(kept);
+        y.resize(kept);
+        width.resize(kept);
+        height.resize(kept);
+
+        if (containedBy != -1)
+        {
+            removeAt(i);
+            --i;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef FREE_RECT_LIST_HPP
+#define FREE_RECT_LIST_HPP
+
+#include <vector>
+#include "atlas_rect.hpp"
+#include "free_rect_kernels.hpp"
+
+/// Instruction sets the free rect scoring can run on, picked once at runtime from what the CPU supports.
+enum SimdLevel
+{
+    SimdScalar,
+    SimdSse41,
+    SimdAvx2
+};
+
+/// The free rectangles of a bin, stored as separate contiguous coordinate arrays (structure of arrays)
+/// so fit tests and placement scores can be computed for several rectangles per instruction.
+class FreeRectList
+{
+public:
+    // Called in the pruning and splitting loops, kept inline
+    int count() const
+    {
+        return (int)x.size();
+    }
+
+    Rect at(int i) const
+    {
+        Rect rect;
+        rect.x = x[i];
+        rect.y = y[i];
+        rect.width = width[i];
+        rect.height = height[i];
+        return rect;
+    }
+
+    void append(const Rect &rect);
+    void removeAt(int i);
+    void clear();
+
+    template <KernelScore Score, bool AllowRotation>
+    Rect findBest(ScoreKernel kernel, int width, int height, int &score1, int &score2) const;
+    void findFits(int width, int height, std::vector<unsigned char> &fits) const;
+    void pruneContained();
+
+    static SimdLevel simdLevel();
+    static ScoreKernel scoreKernel(KernelScore score, bool allowRotation);
+
+private:
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> width;
+    std::vector<int> height;
+    std::vector<unsigned char> flags;
+};
+
+#endif // FREE_RECT_LIST_HPP
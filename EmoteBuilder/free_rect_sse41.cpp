@@ -0,0 +1,48 @@
+// Compiled with SSE4.1 enabled, only called after the CPU has been checked for SSE4.1 support
+#include "free_rect_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <smmintrin.h>
+
+namespace
+{
+class Sse41
+{
+public:
+    typedef __m128i Vec;
+    static const int lanes = 4;
+
+    static inline Vec set1(int value) { return _mm_set1_epi32(value); }
+    static inline Vec laneIndex() { return _mm_setr_epi32(0, 1, 2, 3); }
+    static inline Vec load(const int *source) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(source)); }
+    static inline void store(int *destination, Vec value) { _mm_storeu_si128(reinterpret_cast<__m128i *>(destination), value); }
+    static inline Vec add(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+    static inline Vec sub(Vec a, Vec b) { return _mm_sub_epi32(a, b); }
+    static inline Vec mul(Vec a, Vec b) { return _mm_mullo_epi32(a, b); }
+    static inline Vec min(Vec a, Vec b) { return _mm_min_epi32(a, b); }
+    static inline Vec max(Vec a, Vec b) { return _mm_max_epi32(a, b); }
+    static inline Vec greater(Vec a, Vec b) { return _mm_cmpgt_epi32(a, b); }
+    static inline Vec equal(Vec a, Vec b) { return _mm_cmpeq_epi32(a, b); }
+    static inline Vec bitAnd(Vec a, Vec b) { return _mm_and_si128(a, b); }
+    static inline Vec bitOr(Vec a, Vec b) { return _mm_or_si128(a, b); }
+    static inline Vec select(Vec mask, Vec a, Vec b) { return _mm_blendv_epi8(b, a, mask); }
+    static inline int mask(Vec value) { return _mm_movemask_ps(_mm_castsi128_ps(value)); }
+};
+}
+
+ScoreKernel scoreKernelSse41(KernelScore score, bool allowRotation)
+{
+    return selectScoreKernel<Sse41>(score, allowRotation);
+}
+
+int fitFreeRectsSse41(const int *width, const int *height, int count, int rectWidth, int rectHeight, unsigned char *fits)
+{
+    return fitFreeRects<Sse41>(width, height, count, rectWidth, rectHeight, fits);
+}
+
+int containFreeRectsSse41(const int *x, const int *y, const int *width, const int *height, int begin, int count,
+                          int rectX, int rectY, int rectWidth, int rectHeight, unsigned char *flags)
+{
+    return containFreeRects<Sse41>(x, y, width, height, begin, count, rectX, rectY, rectWidth, rectHeight, flags);
+}
+#endif
@@ -0,0 +1,105 @@
+#include <QtConcurrent>
+#include "allocation_tracker.hpp"
+#include "lod_filter.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LOD_FILTER_SSE2
+#endif
+
+// Rounded average of the four 2x2 source pixels of each target pixel, channel by channel
+static void averageRow(const quint32 *row0, const quint32 *row1, quint32 *target, int sourceWidth, int targetWidth)
+{
+    int x = 0;
+
+#ifdef LOD_FILTER_SSE2
+    // SSE2 is part of every x86-64 target, so unlike the packer kernels this needs no runtime dispatch.
+    // Eight source pixels of each row widen to 16-bit channels, where the sum of four never overflows.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(2);
+    for (; x + 4 <= targetWidth && 2 * x + 8 <= sourceWidth; x += 4)
+    {
+        __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 2 * x));
+        __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 2 * x + 4));
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 2 * x));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 2 * x + 4));
+
+        // Vertical sums, two source pixels per register
+        __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+        __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+        __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+        __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+        // Horizontal sums pair the even source pixels with the odd ones
+        __m128i t01 = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+        __m128i t23 = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67), _mm_unpackhi_epi64(s45, s67));
+        t01 = _mm_srli_epi16(_mm_add_epi16(t01, rounding), 2);
+        t23 = _mm_srli_epi16(_mm_add_epi16(t23, rounding), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(target + x), _mm_packus_epi16(t01, t23));
+    }
+#endif
+
+    // Odd sizes repeat the last column, the same as clamp to edge sampling
+    for (; x < targetWidth; ++x)
+    {
+        int left = std::min(2 * x, sourceWidth - 1);
+        int right = std::min(2 * x + 1, sourceWidth - 1);
+        quint32 pixel = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            quint32 sum = ((row0[left] >> shift) & 0xff) + ((row0[right] >> shift) & 0xff) +
+                          ((row1[left] >> shift) & 0xff) + ((row1[right] >> shift) & 0xff);
+            pixel |= ((sum + 2) >> 2) << shift;
+        }
+        target[x] = pixel;
+    }
+}
+
+void LodFilter::downsampleRows(const QImage &source, QImage &target, int beginRow, int endRow)
+{
+    for (int y = beginRow; y < endRow; ++y)
+    {
+        const quint32 *row0 = reinterpret_cast<const quint32 *>(source.constScanLine(std::min(2 * y, source.height() - 1)));
+        const quint32 *row1 = reinterpret_cast<const quint32 *>(source.constScanLine(std::min(2 * y + 1, source.height() - 1)));
+        quint32 *line = reinterpret_cast<quint32 *>(target.scanLine(y));
+        averageRow(row0, row1, line, source.width(), target.width());
+    }
+}
+
+/// Halves the image in both dimensions, rounding odd sizes up.
+/// @return A premultiplied ARGB32 image, bands of rows are filtered in parallel.
+QImage LodFilter::downsample(const QImage &image)
+{
+    QImage source = image.format() == QImage::Format_ARGB32_Premultiplied
+                    ? image : image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QImage target((source.width() + 1) / 2, (source.height() + 1) / 2, QImage::Format_ARGB32_Premultiplied);
+
+    // Detach once up front, bands write disjoint rows of it
+    target.bits();
+    QList<int> bands;
+    for (int y = 0; y < target.height(); y += bandRows)
+        bands.append(y);
+
+    QtConcurrent::blockingMap(bands, [&source, &target](int beginRow)
+    {
+        downsampleRows(source, target, beginRow, std::min(beginRow + bandRows, target.height()));
+    });
+
+    return target;
+}
+
+/// Downsamples the image repeatedly, each level from the one before it, so the full size atlas is read only once.
+/// @return Levels 1 to levels, half the size of the previous level each.
+QList<QImage> LodFilter::chain(const QImage &image, int levels)
+{
+    AllocationScope allocationScope("render: detail levels");
+    QList<QImage> lods;
+    QImage level = image;
+    for (int i = 0; i < levels; ++i)
+    {
+        level = downsample(level);
+        lods.append(level);
+    }
+
+    return lods;
+}
@@ -0,0 +1,23 @@
+#ifndef LOD_FILTER_HPP
+#define LOD_FILTER_HPP
+
+#include <QImage>
+#include <QList>
+
+/// Builds reduced level of detail variants of an atlas, each half the size of the previous one.
+/// Pixels are averaged in premultiplied alpha with a 2x2 box filter, so transparent neighbours never darken or
+/// tint the edges of a sprite. Sprites must be aligned to 2^levels pixels, with a gutter of that size between them,
+/// for no level to mix texels of two sprites.
+class LodFilter
+{
+public:
+    static QImage downsample(const QImage &image);
+    static QList<QImage> chain(const QImage &image, int levels);
+
+private:
+    static void downsampleRows(const QImage &source, QImage &target, int beginRow, int endRow);
+
+    static const int bandRows = 32;
+};
+
+#endif // LOD_FILTER_HPP
@@ -22,9 +22,45 @@ void Logger::close()
     instance.stream.close();
 }
 
+// Pipeline stages log from worker threads, so writes are serialized
 void Logger::write(const QString& message)
 {
+    QMutexLocker locker(&instance.mutex);
     std::ostream& stream = instance.stream;
     stream << message.toStdString() << std::endl;
     qDebug() << message << "\n";
 }
+
+void BuildLog::setHeld(bool held)
+{
+    flush();
+    QMutexLocker locker(&mutex);
+    this->held = held;
+}
+
+void BuildLog::write(const QString& message)
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (held)
+        {
+            messages.append(message);
+            return;
+        }
+    }
+
+    Logger::write(message);
+}
+
+// Writes the held messages to the application log in one piece
+void BuildLog::flush()
+{
+    QStringList taken;
+    {
+        QMutexLocker locker(&mutex);
+        taken.swap(messages);
+    }
+
+    if (!taken.isEmpty())
+        Logger::write(taken.join("\n"));
+}
@@ -2,7 +2,9 @@
 #define LOGGER_HPP
 
 #include <fstream>
+#include <QMutex>
 #include <QString>
+#include <QStringList>
 
 class Logger
 {
@@ -13,7 +15,24 @@ public:
 private:
     Logger();
     std::ofstream stream;
+    QMutex mutex;
     static Logger instance;
 };
 
+/// The log of one build, so builds never share a log of their own. Messages go to the application log as they are
+/// written, or are held while builds run side by side and written together by flush, so the messages of concurrent
+/// builds don't interleave. A build logs from its helper threads as well, so writes are serialized.
+class BuildLog
+{
+public:
+    void setHeld(bool held);
+    void write(const QString& message);
+    void flush();
+
+private:
+    QMutex          mutex;
+    bool            held = false;
+    QStringList     messages;
+};
+
 #endif
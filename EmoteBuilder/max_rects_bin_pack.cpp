@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <limits>
 #include "atlas_rect.hpp"
 #include "max_rects_bin_pack.hpp"
@@ -8,6 +9,13 @@ MaxRectsBinPack::MaxRectsBinPack()
 }
 
 MaxRectsBinPack::MaxRectsBinPack(int width, int height, bool allowRotation)
+{
+    reset(width, height, allowRotation);
+}
+
+/// Empties the bin and resizes it. Every buffer keeps its capacity, so packing into a reused bin allocates only
+/// when it holds more rects than any earlier packing did.
+void MaxRectsBinPack::reset(int width, int height, bool allowRotation)
 {
     binWidth = width;
     binHeight = height;
@@ -20,30 +28,70 @@ MaxRectsBinPack::MaxRectsBinPack(int width, int height, bool allowRotation)
     n.height = height;
 
     usedRectangles.clear();
+    leftEdges.reset(width + 1);
+    rightEdges.reset(width + 1);
+    topEdges.reset(height + 1);
+    bottomEdges.reset(height + 1);
 
     freeRectangles.clear();
     freeRectangles.append(n);
 }
 
+/// Calls visitor with the PackConfig matching the heuristic and this bin's rotation mode. This is the only place the
+/// configuration is inspected at runtime, everything the visitor calls is specialized for it.
+template <class Visitor>
+auto MaxRectsBinPack::dispatch(FreeRectChoiceHeuristic method, Visitor visitor)
+{
+    switch (method)
+    {
+        case RectBestShortSideFit:
+            return allowRotation ? visitor(PackConfig<RectBestShortSideFit, true>()) : visitor(PackConfig<RectBestShortSideFit, false>());
+        case RectBestLongSideFit:
+            return allowRotation ? visitor(PackConfig<RectBestLongSideFit, true>()) : visitor(PackConfig<RectBestLongSideFit, false>());
+        case RectBottomLeftRule:
+            return allowRotation ? visitor(PackConfig<RectBottomLeftRule, true>()) : visitor(PackConfig<RectBottomLeftRule, false>());
+        case RectContactPointRule:
+            return allowRotation ? visitor(PackConfig<RectContactPointRule, true>()) : visitor(PackConfig<RectContactPointRule, false>());
+        case RectBestAreaFit:
+        default:
+            return allowRotation ? visitor(PackConfig<RectBestAreaFit, true>()) : visitor(PackConfig<RectBestAreaFit, false>());
+    }
+}
+
 /// Inserts the given list of rectangles in an offline/batch mode, possibly rotated.
-/// @param rects The list of rectangles to insert. This vector will be destroyed in the process.
-/// @param dst [out] This list will contain the packed rectangles. The indices will not correspond to that of rects.
+/// @param rects The list of rectangles to insert. They are consumed from a scratch copy, rects itself is left as is.
 /// @param method The rectangle placement rule to use when packing.
-bool MaxRectsBinPack::insert(QList<RectSize> rects, FreeRectChoiceHeuristic method)
+/// @return True if every rectangle could be placed. getMapped holds the packed rectangles, in placement order.
+bool MaxRectsBinPack::insert(const std::vector<RectSize> &rects, FreeRectChoiceHeuristic method)
+{
+    return dispatch(method, [this, &rects](auto config)
+    {
+        return insertBatch<decltype(config)>(rects);
+    });
+}
+
+template <class Config>
+bool MaxRectsBinPack::insertBatch(const std::vector<RectSize> &source)
 {
-    int numRects = rects.count();
-    while (rects.count() > 0)
+    ScoreKernel kernel = FreeRectList::scoreKernel(Config::kernelScore, Config::allowRotation);
+
+    // Assigning reuses the capacity of earlier batches
+    std::vector<RectSize> &rects = pendingRects;
+    rects.assign(source.begin(), source.end());
+
+    int numRects = (int)rects.size();
+    while (!rects.empty())
     {
         int bestScore1 = std::numeric_limits<int>::max();
         int bestScore2 = std::numeric_limits<int>::max();
         int bestRectIndex = -1;
-        Rect bestNode;
+        Rect bestNode = Rect();
 
-        for (int i = 0; i < rects.count(); ++i)
+        for (int i = 0; i < (int)rects.size(); ++i)
         {
             int score1 = 0;
             int score2 = 0;
-            Rect newNode = scoreRect(rects[i].width, rects[i].height, method, score1, score2);
+            Rect newNode = scorePlacement<Config>(rects[i].width, rects[i].height, kernel, score1, score2);
 
             if (score1 < bestScore1 || (score1 == bestScore1 && score2 < bestScore2))
             {
@@ -55,16 +103,41 @@ bool MaxRectsBinPack::insert(QList<RectSize> rects, FreeRectChoiceHeuristic meth
         }
 
         if (bestRectIndex == -1)
-            return usedRectangles.count() == numRects;
+            return (int)usedRectangles.size() == numRects;
 
         placeRect(bestNode);
-        rects.removeAt(bestRectIndex);
+        rects.erase(rects.begin() + bestRectIndex);
     }
 
-    return usedRectangles.count() == numRects;
+    return (int)usedRectangles.size() == numRects;
+}
+
+/// Inserts the given list of rectangles one at a time in the order they are given, possibly rotated.
+/// Unlike the batch insert, the order of rects decides the layout, which lets callers search over orderings.
+/// @param rects The list of rectangles to insert, in placement order.
+/// @param method The rectangle placement rule to use when packing.
+/// @return True if every rectangle could be placed.
+bool MaxRectsBinPack::insertInOrder(const std::vector<RectSize> &rects, FreeRectChoiceHeuristic method)
+{
+    return dispatch(method, [this, &rects](auto config)
+    {
+        typedef decltype(config) Config;
+        ScoreKernel kernel = FreeRectList::scoreKernel(Config::kernelScore, Config::allowRotation);
+
+        bool allPlaced = true;
+        for (const RectSize &rect : rects)
+        {
+            Rect newNode = insertSingle<Config>(rect.width, rect.height, kernel);
+            if (newNode.height == 0)
+                allPlaced = false;
+        }
+
+        return allPlaced;
+    });
 }
 
-QList<Rect> MaxRectsBinPack::getMapped()
+// The placed rectangles, valid until the packer is reset
+const std::vector<Rect> &MaxRectsBinPack::getMapped() const
 {
     return usedRectangles;
 }
@@ -73,35 +146,24 @@ QList<Rect> MaxRectsBinPack::getMapped()
 /// Inserts a single rectangle into the bin, possibly rotated.
 Rect MaxRectsBinPack::insert(int width, int height, FreeRectChoiceHeuristic method)
 {
-    Rect newNode;
+    return dispatch(method, [this, width, height](auto config)
+    {
+        typedef decltype(config) Config;
+        return insertSingle<Config>(width, height, FreeRectList::scoreKernel(Config::kernelScore, Config::allowRotation));
+    });
+}
+
+template <class Config>
+Rect MaxRectsBinPack::insertSingle(int width, int height, ScoreKernel kernel)
+{
     int score1 = 0; // Unused in this function. We don't need to know the score after finding the position.
     int score2 = 0;
-    switch (method)
-    {
-        case RectBestShortSideFit: newNode = findPositionForNewNodeBestShortSideFit(width, height, score1, score2); break;
-        case RectBottomLeftRule: newNode = findPositionForNewNodeBottomLeft(width, height, score1, score2); break;
-        case RectContactPointRule: newNode = findPositionForNewNodeContactPoint(width, height, score1); break;
-        case RectBestLongSideFit: newNode = findPositionForNewNodeBestLongSideFit(width, height, score2, score1); break;
-        case RectBestAreaFit: newNode = findPositionForNewNodeBestAreaFit(width, height, score1, score2); break;
-    }
+    Rect newNode = scorePlacement<Config>(width, height, kernel, score1, score2);
 
     if (newNode.height == 0)
         return newNode;
 
-    int numRectanglesToProcess = freeRectangles.count();
-    for (int i = 0; i < numRectanglesToProcess; ++i)
-    {
-        if (splitFreeNode(freeRectangles[i], newNode))
-        {
-            freeRectangles.removeAt(i);
-            --i;
-            --numRectanglesToProcess;
-        }
-    }
-
-    pruneFreeList();
-
-    usedRectangles.append(newNode);
+    placeRect(newNode);
     return newNode;
 }
 
@@ -109,7 +171,7 @@ Rect MaxRectsBinPack::insert(int width, int height, FreeRectChoiceHeuristic meth
 float MaxRectsBinPack::occupancy()
 {
     long usedSurfaceArea = 0;
-    for (int i = 0; i < usedRectangles.count(); ++i)
+    for (size_t i = 0; i < usedRectangles.size(); ++i)
         usedSurfaceArea += usedRectangles[i].width * usedRectangles[i].height;
 
     return (float)usedSurfaceArea / (float)(binWidth * binHeight);
@@ -118,7 +180,7 @@ float MaxRectsBinPack::occupancy()
 int MaxRectsBinPack::wastedBinArea()
 {
     long usedSurfaceArea = 0;
-    for (int i = 0; i < usedRectangles.count(); ++i)
+    for (size_t i = 0; i < usedRectangles.size(); ++i)
         usedSurfaceArea += usedRectangles[i].width * usedRectangles[i].height;
 
     return (int)((long)(binWidth * binHeight) - usedSurfaceArea);
@@ -130,18 +192,30 @@ int MaxRectsBinPack::wastedBinArea()
 /// @return This struct identifies where the rectangle would be placed if it were placed.
 Rect MaxRectsBinPack::scoreRect(int width, int height, FreeRectChoiceHeuristic method, int &score1, int &score2)
 {
-    Rect newNode;
+    return dispatch(method, [this, width, height, &score1, &score2](auto config)
+    {
+        typedef decltype(config) Config;
+        return scorePlacement<Config>(width, height, FreeRectList::scoreKernel(Config::kernelScore, Config::allowRotation),
+                                      score1, score2);
+    });
+}
+
+/// Specialized body of scoreRect.
+/// @param kernel The vectorized free rect kernel for Config, resolved once by the caller.
+template <class Config>
+Rect MaxRectsBinPack::scorePlacement(int width, int height, ScoreKernel kernel, int &score1, int &score2)
+{
+    Rect newNode = Rect();
     score1 = std::numeric_limits<int>::max();
     score2 = std::numeric_limits<int>::max();
-    switch (method)
+    if constexpr (Config::method == RectContactPointRule)
+    {
+        newNode = findPositionForNewNodeContactPoint<Config::allowRotation>(width, height, score1);
+        score1 = -score1; // Reverse since we are minimizing, but for contact point score bigger is better.
+    }
+    else
     {
-        case RectBestShortSideFit: newNode = findPositionForNewNodeBestShortSideFit(width, height, score1, score2); break;
-        case RectBottomLeftRule: newNode = findPositionForNewNodeBottomLeft(width, height, score1, score2); break;
-        case RectContactPointRule: newNode = findPositionForNewNodeContactPoint(width, height, score1);
-            score1 = -score1; // Reverse since we are minimizing, but for contact point score bigger is better.
-            break;
-        case RectBestLongSideFit: newNode = findPositionForNewNodeBestLongSideFit(width, height, score2, score1); break;
-        case RectBestAreaFit: newNode = findPositionForNewNodeBestAreaFit(width, height, score1, score2); break;
+        newNode = freeRectangles.findBest<Config::kernelScore, Config::allowRotation>(kernel, width, height, score1, score2);
     }
 
     // Cannot fit the current rectangle.
@@ -170,239 +244,97 @@ void MaxRectsBinPack::placeRect(Rect node)
 
     pruneFreeList();
 
-    usedRectangles.append(node);
+    addUsedRect(node);
 }
 
-/// Computes the placement score for the -CP variant.
-int MaxRectsBinPack::contactPointScoreNode(int x, int y, int width, int height)
+/// Records a placed rectangle and indexes its four sides for contact scoring.
+void MaxRectsBinPack::addUsedRect(const Rect &node)
 {
-    int score = 0;
-
-    if (x == 0 || x + width == binWidth)
-        score += height;
-    if (y == 0 || y + height == binHeight)
-        score += width;
-
-    for (int i = 0; i < usedRectangles.count(); ++i)
-    {
-        if (usedRectangles[i].x == x + width || usedRectangles[i].x + usedRectangles[i].width == x)
-            score += commonIntervalLength(usedRectangles[i].y, usedRectangles[i].y + usedRectangles[i].height, y, y + height);
-        if (usedRectangles[i].y == y + height || usedRectangles[i].y + usedRectangles[i].height == y)
-            score += commonIntervalLength(usedRectangles[i].x, usedRectangles[i].x + usedRectangles[i].width, x, x + width);
-    }
-    return score;
-}
-
-Rect MaxRectsBinPack::findPositionForNewNodeBottomLeft(int width, int height, int &bestY, int &bestX)
-{
-    Rect bestNode;
-
-    bestY = std::numeric_limits<int>::max();
-
-    for (int i = 0; i < freeRectangles.count(); ++i)
-    {
-        // Try to place the rectangle in upright (non-flipped) orientation.
-        if (freeRectangles[i].width >= width && freeRectangles[i].height >= height)
-        {
-            int topSideY = freeRectangles[i].y + height;
-            if (topSideY < bestY || (topSideY == bestY && freeRectangles[i].x < bestX))
-            {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
-                bestNode.width = width;
-                bestNode.height = height;
-                bestY = topSideY;
-                bestX = freeRectangles[i].x;
-            }
-        }
-        if (allowRotation && freeRectangles[i].width >= height && freeRectangles[i].height >= width)
-        {
-            int topSideY = freeRectangles[i].y + width;
-            if (topSideY < bestY || (topSideY == bestY && freeRectangles[i].x < bestX))
-            {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
-                bestNode.width = height;
-                bestNode.height = width;
-                bestY = topSideY;
-                bestX = freeRectangles[i].x;
-            }
-        }
-    }
-    return bestNode;
+    EdgeSpan vertical;
+    vertical.start = node.y;
+    vertical.end = node.y + node.height;
+    leftEdges.add(node.x, vertical);
+    rightEdges.add(node.x + node.width, vertical);
+
+    EdgeSpan horizontal;
+    horizontal.start = node.x;
+    horizontal.end = node.x + node.width;
+    topEdges.add(node.y, horizontal);
+    bottomEdges.add(node.y + node.height, horizontal);
+
+    usedRectangles.push_back(node);
 }
 
-Rect MaxRectsBinPack::findPositionForNewNodeBestShortSideFit(int width, int height, int &bestShortSideFit, int &bestLongSideFit)
+/// Sums the overlap of [start, end) with every indexed side lying on the given line.
+int MaxRectsBinPack::edgeContactLength(const EdgeIndex &edges, int line, int start, int end)
 {
-    Rect bestNode;
-    //memset(&bestNode, 0, sizeof(Rect));
-
-    bestShortSideFit = std::numeric_limits<int>::max();
-
-    for (int i = 0; i < freeRectangles.count(); ++i)
-    {
-        // Try to place the rectangle in upright (non-flipped) orientation.
-        if (freeRectangles[i].width >= width && freeRectangles[i].height >= height)
-        {
-            int leftoverHoriz = std::abs(freeRectangles[i].width - width);
-            int leftoverVert = std::abs(freeRectangles[i].height - height);
-            int shortSideFit = std::min(leftoverHoriz, leftoverVert);
-            int longSideFit = std::max(leftoverHoriz, leftoverVert);
-
-            if (shortSideFit < bestShortSideFit || (shortSideFit == bestShortSideFit && longSideFit < bestLongSideFit))
-            {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
-                bestNode.width = width;
-                bestNode.height = height;
-                bestShortSideFit = shortSideFit;
-                bestLongSideFit = longSideFit;
-            }
-        }
-
-        if (allowRotation && freeRectangles[i].width >= height && freeRectangles[i].height >= width)
-        {
-            int flippedLeftoverHoriz = std::abs(freeRectangles[i].width - height);
-            int flippedLeftoverVert = std::abs(freeRectangles[i].height - width);
-            int flippedShortSideFit = std::min(flippedLeftoverHoriz, flippedLeftoverVert);
-            int flippedLongSideFit = std::max(flippedLeftoverHoriz, flippedLeftoverVert);
+    const std::vector<EdgeSpan> *spans = edges.find(line);
+    if (!spans)
+        return 0;
 
-            if (flippedShortSideFit < bestShortSideFit || (flippedShortSideFit == bestShortSideFit && flippedLongSideFit < bestLongSideFit))
-            {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
-                bestNode.width = height;
-                bestNode.height = width;
-                bestShortSideFit = flippedShortSideFit;
-                bestLongSideFit = flippedLongSideFit;
-            }
-        }
-    }
-    return bestNode;
+    int length = 0;
+    for (const EdgeSpan &span : *spans)
+        length += commonIntervalLength(span.start, span.end, start, end);
+    return length;
 }
 
-Rect MaxRectsBinPack::findPositionForNewNodeBestLongSideFit(int width, int height, int &bestShortSideFit, int &bestLongSideFit)
+/// Computes the placement score for the -CP variant.
+/// Only used rectangles with a side on one of the candidate's four side lines can touch it, and those are looked up
+/// in the edge indexes instead of scanning every used rectangle.
+int MaxRectsBinPack::contactPointScoreNode(int x, int y, int width, int height)
 {
-    Rect bestNode;
-    bestLongSideFit = std::numeric_limits<int>::max();
-
-    for (int i = 0; i < freeRectangles.count(); ++i)
-    {
-        // Try to place the rectangle in upright (non-flipped) orientation.
-        if (freeRectangles[i].width >= width && freeRectangles[i].height >= height)
-        {
-            int leftoverHoriz = std::abs(freeRectangles[i].width - width);
-            int leftoverVert = std::abs(freeRectangles[i].height - height);
-            int shortSideFit = std::min(leftoverHoriz, leftoverVert);
-            int longSideFit = std::max(leftoverHoriz, leftoverVert);
+    int score = 0;
 
-            if (longSideFit < bestLongSideFit || (longSideFit == bestLongSideFit && shortSideFit < bestShortSideFit))
-            {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
-                bestNode.width = width;
-                bestNode.height = height;
-                bestShortSideFit = shortSideFit;
-                bestLongSideFit = longSideFit;
-            }
-        }
+    if (x == 0 || x + width == binWidth)
+        score += height;
+    if (y == 0 || y + height == binHeight)
+        score += width;
 
-        if (allowRotation && freeRectangles[i].width >= height && freeRectangles[i].height >= width)
-        {
-            int leftoverHoriz =std::abs(freeRectangles[i].width - height);
-            int leftoverVert = std::abs(freeRectangles[i].height - width);
-            int shortSideFit = std::min(leftoverHoriz, leftoverVert);
-            int longSideFit = std::max(leftoverHoriz, leftoverVert);
+    // Used rects whose left side touches our right side, whose right side touches our left side, and likewise vertically
+    score += edgeContactLength(leftEdges, x + width, y, y + height);
+    score += edgeContactLength(rightEdges, x, y, y + height);
+    score += edgeContactLength(topEdges, y + height, x, x + width);
+    score += edgeContactLength(bottomEdges, y, x, x + width);
 
-            if (longSideFit < bestLongSideFit || (longSideFit == bestLongSideFit && shortSideFit < bestShortSideFit))
-            {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
-                bestNode.width = height;
-                bestNode.height = width;
-                bestShortSideFit = shortSideFit;
-                bestLongSideFit = longSideFit;
-            }
-        }
-    }
-    return bestNode;
+    return score;
 }
 
-Rect MaxRectsBinPack::findPositionForNewNodeBestAreaFit(int width, int height, int &bestAreaFit, int &bestShortSideFit)
+template <bool AllowRotation>
+Rect MaxRectsBinPack::findPositionForNewNodeContactPoint(int width, int height, int &bestContactScore)
 {
-    Rect bestNode;
+    Rect bestNode = Rect();
+    bestContactScore = -1;
 
-    bestAreaFit = std::numeric_limits<int>::max();
+    // The fit test is vectorized, contact scores depend on the used rects and are computed per fitting rect
+    freeRectangles.findFits(width, height, fits);
 
     for (int i = 0; i < freeRectangles.count(); ++i)
     {
-        int areaFit = freeRectangles[i].width * freeRectangles[i].height - width * height;
-
-        // Try to place the rectangle in upright (non-flipped) orientation.
-        if (freeRectangles[i].width >= width && freeRectangles[i].height >= height)
-        {
-            int leftoverHoriz = std::abs(freeRectangles[i].width - width);
-            int leftoverVert = std::abs(freeRectangles[i].height - height);
-            int shortSideFit = std::min(leftoverHoriz, leftoverVert);
-
-            if (areaFit < bestAreaFit || (areaFit == bestAreaFit && shortSideFit < bestShortSideFit))
-            {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
-                bestNode.width = width;
-                bestNode.height = height;
-                bestShortSideFit = shortSideFit;
-                bestAreaFit = areaFit;
-            }
-        }
+        if (fits[i] == 0)
+            continue;
 
-        if (allowRotation && freeRectangles[i].width >= height && freeRectangles[i].height >= width)
-        {
-            int leftoverHoriz = std::abs(freeRectangles[i].width - height);
-            int leftoverVert = std::abs(freeRectangles[i].height - width);
-            int shortSideFit = std::min(leftoverHoriz, leftoverVert);
+        Rect freeRect = freeRectangles.at(i);
 
-            if (areaFit < bestAreaFit || (areaFit == bestAreaFit && shortSideFit < bestShortSideFit))
-            {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
-                bestNode.width = height;
-                bestNode.height = width;
-                bestShortSideFit = shortSideFit;
-                bestAreaFit = areaFit;
-            }
-        }
-    }
-    return bestNode;
-}
-
-Rect MaxRectsBinPack::findPositionForNewNodeContactPoint(int width, int height, int &bestContactScore)
-{
-    Rect bestNode;
-    bestContactScore = -1;
-
-    for (int i = 0; i < freeRectangles.count(); ++i)
-    {
         // Try to place the rectangle in upright (non-flipped) orientation.
-        if (freeRectangles[i].width >= width && freeRectangles[i].height >= height)
+        if (fits[i] & 1)
         {
-            int score = contactPointScoreNode(freeRectangles[i].x, freeRectangles[i].y, width, height);
+            int score = contactPointScoreNode(freeRect.x, freeRect.y, width, height);
             if (score > bestContactScore)
             {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
+                bestNode.x = freeRect.x;
+                bestNode.y = freeRect.y;
                 bestNode.width = width;
                 bestNode.height = height;
                 bestContactScore = score;
             }
         }
-        if (allowRotation && freeRectangles[i].width >= height && freeRectangles[i].height >= width)
+        if (AllowRotation && (fits[i] & 2))
         {
-            int score = contactPointScoreNode(freeRectangles[i].x, freeRectangles[i].y, width, height);
+            int score = contactPointScoreNode(freeRect.x, freeRect.y, height, width);
             if (score > bestContactScore)
             {
-                bestNode.x = freeRectangles[i].x;
-                bestNode.y = freeRectangles[i].y;
+                bestNode.x = freeRect.x;
+                bestNode.y = freeRect.y;
                 bestNode.width = height;
                 bestNode.height = width;
                 bestContactScore = score;
@@ -486,23 +418,7 @@ void MaxRectsBinPack::pruneFreeList()
     */
 
     /// Go through each pair and remove any rectangle that is redundant.
-    for (int i = 0; i < freeRectangles.count(); ++i)
-    {
-        for (int j = i + 1; j < freeRectangles.count(); ++j)
-        {
-            if (Rect::isContainedIn(freeRectangles[i], freeRectangles.at(j)))
-            {
-                freeRectangles.removeAt(i);
-                --i;
-                break;
-            }
-            if (Rect::isContainedIn(freeRectangles.at(j), freeRectangles[i]))
-            {
-                freeRectangles.removeAt(j);
-                --j;
-            }
-        }
-    }
+    freeRectangles.pruneContained();
 }
 
 /// Returns 0 if the two intervals i1 and i2 are disjoint, or the length of their overlap otherwise.
@@ -512,3 +428,45 @@ int MaxRectsBinPack::commonIntervalLength(int i1start, int i1end, int i2start, i
         return 0;
     return std::min(i1end, i2end) - std::max(i1start, i2start);
 }
+
+void EdgeIndex::reset(int lineCount)
+{
+    for (int line : usedLines)
+        lines[line].clear();
+    usedLines.clear();
+
+    if ((int)lines.size() < lineCount)
+        lines.resize(lineCount);
+}
+
+void EdgeIndex::add(int line, const EdgeSpan &span)
+{
+    if (line >= (int)lines.size())
+        lines.resize(line + 1);
+    if (lines[line].empty())
+        usedLines.push_back(line);
+    lines[line].push_back(span);
+}
+
+/// Hands out a packer reset to the given bin, reusing one released by the last pool reset when there is one.
+MaxRectsBinPack &PackerPool::acquire(int width, int height, bool allowRotation)
+{
+    if (acquired == (int)packers.size())
+        packers.emplace_back();
+
+    MaxRectsBinPack &packer = packers[acquired++];
+    packer.reset(width, height, allowRotation);
+    return packer;
+}
+
+// Releases every acquired packer for reuse
+void PackerPool::reset()
+{
+    acquired = 0;
+}
+
+// Packers allocated by the pool so far
+int PackerPool::size() const
+{
+    return (int)packers.size();
+}
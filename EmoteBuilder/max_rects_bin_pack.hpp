@@ -1,8 +1,17 @@
 #ifndef MAX_RECTS_BIN_PACK_HPP
 #define MAX_RECTS_BIN_PACK_HPP
 
-#include <QList>
+#include <deque>
+#include <vector>
 #include "atlas_rect.hpp"
+#include "free_rect_list.hpp"
+
+/// The extent of one side of a used rectangle along the edge it lies on.
+class EdgeSpan
+{
+public:
+    int start, end;
+};
 
 /// Specifies the different heuristic rules that can be used when deciding where to place a new rectangle.
 enum FreeRectChoiceHeuristic
@@ -14,35 +23,104 @@ enum FreeRectChoiceHeuristic
     RectContactPointRule /// -CP: Choosest the placement where the rectangle touches other rects as much as possible.
 };
 
+/// Fixes the heuristic and rotation mode of a packing run at compile time, so the placement search is instantiated
+/// once per combination and its loops carry no branches on either.
+template <FreeRectChoiceHeuristic Method, bool AllowRotation>
+class PackConfig
+{
+public:
+    static constexpr FreeRectChoiceHeuristic method = Method;
+    static constexpr bool allowRotation = AllowRotation;
+
+    // Free rect score of the vectorized search, unused by -CP which scores contacts instead
+    static constexpr KernelScore kernelScore = Method == RectBottomLeftRule ? ScoreBottomLeft :
+                                               Method == RectBestShortSideFit ? ScoreShortSide :
+                                               Method == RectBestLongSideFit ? ScoreLongSide : ScoreArea;
+};
+
+/// Sides of used rectangles keyed by the coordinate of the line they lie on. Lines are indexed directly by coordinate
+/// and only the lines that received sides are cleared on reset, so a reused index keeps all of its buffers.
+class EdgeIndex
+{
+public:
+    void reset(int lineCount);
+    void add(int line, const EdgeSpan &span);
+
+    // Called for every contact score, kept inline
+    const std::vector<EdgeSpan> *find(int line) const
+    {
+        if (line < 0 || line >= (int)lines.size() || lines[line].empty())
+            return nullptr;
+        return &lines[line];
+    }
+
+private:
+    std::vector<std::vector<EdgeSpan>> lines;
+    std::vector<int> usedLines;
+};
+
 class MaxRectsBinPack
 {
 public:
     MaxRectsBinPack();
     MaxRectsBinPack(int width, int height, bool allowRotation);
 
-    bool insert(QList<RectSize> rects, FreeRectChoiceHeuristic method);
-    QList<Rect> getMapped();
+    void reset(int width, int height, bool allowRotation);
+    bool insert(const std::vector<RectSize> &rects, FreeRectChoiceHeuristic method);
+    bool insertInOrder(const std::vector<RectSize> &rects, FreeRectChoiceHeuristic method);
+    const std::vector<Rect> &getMapped() const;
     Rect insert(int width, int height, FreeRectChoiceHeuristic method);
     float occupancy();
     int wastedBinArea();
     Rect scoreRect(int width, int height, FreeRectChoiceHeuristic method, int &score1, int &score2);
     void placeRect(Rect node);
+    void addUsedRect(const Rect &node);
     int contactPointScoreNode(int x, int y, int width, int height);
-    Rect findPositionForNewNodeBottomLeft(int width, int height, int &bestY, int &bestX);
-    Rect findPositionForNewNodeBestShortSideFit(int width, int height, int &bestShortSideFit, int &bestLongSideFit);
-    Rect findPositionForNewNodeBestLongSideFit(int width, int height, int &bestShortSideFit, int &bestLongSideFit);
-    Rect findPositionForNewNodeBestAreaFit(int width, int height, int &bestAreaFit, int &bestShortSideFit);
+    template <class Visitor>
+    auto dispatch(FreeRectChoiceHeuristic method, Visitor visitor);
+    template <class Config>
+    bool insertBatch(const std::vector<RectSize> &rects);
+    template <class Config>
+    Rect insertSingle(int width, int height, ScoreKernel kernel);
+    template <class Config>
+    Rect scorePlacement(int width, int height, ScoreKernel kernel, int &score1, int &score2);
+    template <bool AllowRotation>
     Rect findPositionForNewNodeContactPoint(int width, int height, int &bestContactScore);
     bool splitFreeNode(Rect freeNode, Rect usedNode);
     void pruneFreeList();
     int commonIntervalLength(int i1start, int i1end, int i2start, int i2end);
+    int edgeContactLength(const EdgeIndex &edges, int line, int start, int end);
 
     bool        allowRotation = false;
     int         binWidth = 0;
     int         binHeight = 0;
 
-    QList<Rect> usedRectangles;
-    QList<Rect> freeRectangles;
+    std::vector<Rect> usedRectangles;
+
+    // Sides of the used rectangles keyed by their coordinate, so contact scoring only visits touching sides
+    EdgeIndex   leftEdges;
+    EdgeIndex   rightEdges;
+    EdgeIndex   topEdges;
+    EdgeIndex   bottomEdges;
+    FreeRectList freeRectangles;
+
+    // Scratch buffers, kept so that a reset packer places rects without allocating
+    std::vector<RectSize> pendingRects;
+    std::vector<unsigned char> fits;
+};
+
+/// Packers that are reset and reused across trials, so their buffers are allocated by the first trials only.
+/// A packer acquired from the pool stays valid until the pool is reset, after which it may be handed out again.
+class PackerPool
+{
+public:
+    MaxRectsBinPack &acquire(int width, int height, bool allowRotation);
+    void reset();
+    int size() const;
+
+private:
+    std::deque<MaxRectsBinPack> packers; // A deque never moves its elements, so acquired references stay valid
+    int             acquired = 0;
 };
 
 #endif // MAX_RECTS_BIN_PACK_HPP
@@ -0,0 +1,76 @@
+#include <QFile>
+#include "memory_usage.hpp"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+#if defined(Q_OS_LINUX)
+// Reads a "Key:   1234 kB" line of /proc/self/status
+static qint64 readStatusBytes(const char *key)
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QFile::ReadOnly))
+        return -1;
+
+    for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine())
+    {
+        if (line.startsWith(key))
+            return line.mid(qstrlen(key)).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+
+    return -1;
+}
+#endif
+
+qint64 MemoryUsage::residentBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (qint64)counters.WorkingSetSize;
+    return -1;
+#elif defined(Q_OS_LINUX)
+    return readStatusBytes("VmRSS:");
+#else
+    return -1;
+#endif
+}
+
+/// The highest resident set size since the process started, or since the last resetPeak where that is supported.
+qint64 MemoryUsage::peakResidentBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (qint64)counters.PeakWorkingSetSize;
+    return -1;
+#elif defined(Q_OS_LINUX)
+    return readStatusBytes("VmHWM:");
+#elif defined(Q_OS_UNIX)
+    // ru_maxrss is in bytes on macOS
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return (qint64)usage.ru_maxrss;
+    return -1;
+#else
+    return -1;
+#endif
+}
+
+/// Restarts peak tracking, so the next peak covers one build only. Only Linux supports this.
+/// @return False if the peak keeps counting from process start.
+bool MemoryUsage::resetPeak()
+{
+#if defined(Q_OS_LINUX)
+    QFile clearRefs("/proc/self/clear_refs");
+    if (!clearRefs.open(QFile::WriteOnly))
+        return false;
+    return clearRefs.write("5") == 1;
+#else
+    return false;
+#endif
+}
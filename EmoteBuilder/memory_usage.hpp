@@ -0,0 +1,16 @@
+#ifndef MEMORY_USAGE_HPP
+#define MEMORY_USAGE_HPP
+
+#include <QtGlobal>
+
+/// Reads the resident set size of this process from the operating system. Values are in bytes, or -1 where the
+/// platform doesn't report them.
+class MemoryUsage
+{
+public:
+    static qint64 residentBytes();
+    static qint64 peakResidentBytes();
+    static bool resetPeak();
+};
+
+#endif // MEMORY_USAGE_HPP
@@ -0,0 +1,160 @@
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QtConcurrent>
+#include "pack_optimizer.hpp"
+
+PackOptimizer::PackOptimizer(int timeBudget, quint32 seed, bool allowRotation)
+{
+    this->timeBudget = timeBudget;
+    this->seed = seed;
+    this->allowRotation = allowRotation;
+}
+
+// Number of trials evaluated by the last call to optimize
+int PackOptimizer::trialCount()
+{
+    return trialsRun;
+}
+
+// A trial that places every rect always beats one that doesn't, then less waste wins,
+// and remaining ties go to the earliest trial so the outcome never depends on thread timing
+bool PackOptimizer::isBetter(PackTrial &trial, PackTrial &best)
+{
+    if (trial.allUsed != best.allUsed)
+        return trial.allUsed;
+
+    int wasted = trial.binPacker.wastedBinArea();
+    int bestWasted = best.binPacker.wastedBinArea();
+    if (wasted != bestWasted)
+        return wasted < bestWasted;
+
+    return trial.index < best.index;
+}
+
+// Fills the ordered rects of a trial, reusing its buffers
+void PackOptimizer::orderRects(const std::vector<RectSize> &rects, PackTrial &trial)
+{
+    std::vector<qint64> &keys = trial.keys;
+    keys.clear();
+    QRandomGenerator random(seed + (quint32)trial.index);
+    for (const RectSize &rs : rects)
+    {
+        qint64 area = (qint64)rs.width * rs.height;
+        switch (trial.ordering)
+        {
+            case OrderByArea: keys.push_back(area); break;
+            case OrderByPerimeter: keys.push_back(rs.width + rs.height); break;
+            case OrderByMaxSide: keys.push_back(std::max(rs.width, rs.height)); break;
+            case OrderByHeight: keys.push_back(rs.height); break;
+            case OrderByWidth: keys.push_back(rs.width); break;
+            case OrderRandomized:
+                // Jitter the area by up to 25% either way so that similarly sized rects trade places
+                keys.push_back(area + (qint64)(area * (random.generateDouble() - 0.5) * 0.5));
+                break;
+        }
+    }
+
+    std::vector<int> &order = trial.order;
+    order.clear();
+    for (int i = 0; i < (int)rects.size(); ++i)
+        order.push_back(i);
+
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b)
+    {
+        return keys[a] > keys[b];
+    });
+
+    trial.orderedRects.clear();
+    for (int i : order)
+        trial.orderedRects.push_back(rects[i]);
+}
+
+// Prepares a batch slot for a trial, growing the slots only the first time a batch this large runs
+void PackOptimizer::setTrial(int slot, int index, RectOrdering ordering, FreeRectChoiceHeuristic heuristic)
+{
+    if (slot >= (int)trials.size())
+        trials.resize(slot + 1);
+
+    PackTrial &trial = trials[slot];
+    trial.index = index;
+    trial.ordering = ordering;
+    trial.heuristic = heuristic;
+    trial.allUsed = false;
+}
+
+/// Packs the rects in many different orders and keeps the best layout found within the time budget.
+/// The trial sequence is fixed for a given seed and every batch runs to completion, so the budget only
+/// decides how many batches are evaluated.
+/// @param bestBinPacker [out] Receives the best layout found, by swapping buffers with it.
+/// @return True if every rect fits in the best layout.
+bool PackOptimizer::optimize(int width, int height, const std::vector<RectSize> &rects, MaxRectsBinPack &bestBinPacker)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    FreeRectChoiceHeuristic heuristics[4] = { RectBestAreaFit,
+                                              RectBestLongSideFit,
+                                              RectBestShortSideFit,
+                                              RectBottomLeftRule,
+                                            };
+
+    RectOrdering orderings[5] = { OrderByArea,
+                                  OrderByPerimeter,
+                                  OrderByMaxSide,
+                                  OrderByHeight,
+                                  OrderByWidth,
+                                };
+
+    // The first batch covers every fixed ordering with every heuristic, later batches are random perturbations
+    int batchCount = 0;
+    for (auto ordering : orderings)
+    {
+        for (auto heuristic : heuristics)
+        {
+            setTrial(batchCount, batchCount, ordering, heuristic);
+            batchCount++;
+        }
+    }
+
+    int batchSize = std::max(QThread::idealThreadCount(), 1);
+    best.index = -1;
+    trialsRun = 0;
+
+    while (batchCount > 0)
+    {
+        QtConcurrent::blockingMap(trials.begin(), trials.begin() + batchCount, [this, width, height, &rects](PackTrial &trial)
+        {
+            orderRects(rects, trial);
+            trial.binPacker.reset(width, height, allowRotation);
+            trial.allUsed = trial.binPacker.insertInOrder(trial.orderedRects, trial.heuristic);
+        });
+
+        for (int i = 0; i < batchCount; ++i)
+        {
+            PackTrial &trial = trials[i];
+            if (best.index == -1 || isBetter(trial, best))
+            {
+                best.index = trial.index;
+                best.allUsed = trial.allUsed;
+                std::swap(best.binPacker, trial.binPacker);
+            }
+        }
+
+        trialsRun += batchCount;
+        batchCount = 0;
+
+        if (timer.elapsed() >= timeBudget || trialsRun >= maxTrialCount)
+            break;
+
+        for (int i = 0; i < batchSize; ++i)
+        {
+            int index = trialsRun + i;
+            setTrial(i, index, OrderRandomized, heuristics[index % 4]);
+            batchCount++;
+        }
+    }
+
+    std::swap(bestBinPacker, best.binPacker);
+    return best.allUsed;
+}
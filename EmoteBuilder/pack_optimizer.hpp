@@ -0,0 +1,60 @@
+#ifndef PACK_OPTIMIZER_HPP
+#define PACK_OPTIMIZER_HPP
+
+#include <QList>
+#include <vector>
+#include "max_rects_bin_pack.hpp"
+
+/// Specifies the order in which rectangles are fed to the packer during a multi-start trial.
+enum RectOrdering
+{
+    OrderByArea, /// Largest area first.
+    OrderByPerimeter, /// Largest perimeter first.
+    OrderByMaxSide, /// Longest side first.
+    OrderByHeight, /// Tallest first.
+    OrderByWidth, /// Widest first.
+    OrderRandomized /// Area order with seeded random perturbations.
+};
+
+/// One slot of a trial batch. Slots are reused by every batch, so the packer and the ordering buffers are allocated
+/// by the first batches only.
+class PackTrial
+{
+public:
+    int                     index;
+    RectOrdering            ordering;
+    FreeRectChoiceHeuristic heuristic;
+    MaxRectsBinPack         binPacker;
+    bool                    allUsed;
+
+    // Ordering scratch
+    std::vector<qint64>     keys;
+    std::vector<int>        order;
+    std::vector<RectSize>   orderedRects;
+};
+
+class PackOptimizer
+{
+public:
+    PackOptimizer(int timeBudget, quint32 seed, bool allowRotation);
+    bool optimize(int width, int height, const std::vector<RectSize> &rects, MaxRectsBinPack &bestBinPacker);
+    int trialCount();
+
+    static bool isBetter(PackTrial &trial, PackTrial &best);
+
+private:
+    void orderRects(const std::vector<RectSize> &rects, PackTrial &trial);
+    void setTrial(int slot, int index, RectOrdering ordering, FreeRectChoiceHeuristic heuristic);
+
+    int             timeBudget = 0;
+    quint32         seed = 0;
+    bool            allowRotation = true;
+    int             trialsRun = 0;
+
+    std::vector<PackTrial> trials;
+    PackTrial       best; // Takes over the packer of a better trial by swapping buffers with it
+
+    static const int maxTrialCount = 1024;
+};
+
+#endif // PACK_OPTIMIZER_HPP
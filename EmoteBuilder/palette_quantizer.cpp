@@ -0,0 +1,322 @@
+#include <QHash>
+#include <QtConcurrent>
+#include "palette_quantizer.hpp"
+
+// 4x4 Bayer matrix for ordered dithering, which unlike error diffusion lets every tile be mapped independently
+static const int bayerMatrix[4][4] = { {  0,  8,  2, 10 },
+                                       { 12,  4, 14,  6 },
+                                       {  3, 11,  1,  9 },
+                                       { 15,  7, 13,  5 } };
+
+static const int ditherSpread = 16;
+static const int tileSize = 256;
+
+// Converts a color to a premultiplied RGBA point
+static void toPoint(QRgb color, int point[4])
+{
+    int alpha = qAlpha(color);
+    point[0] = (qRed(color) * alpha + 127) / 255;
+    point[1] = (qGreen(color) * alpha + 127) / 255;
+    point[2] = (qBlue(color) * alpha + 127) / 255;
+    point[3] = alpha;
+}
+
+static int squaredDistance(const int pointA[4], const int pointB[4])
+{
+    int distance = 0;
+    for (int c = 0; c < 4; ++c)
+        distance += (pointA[c] - pointB[c]) * (pointA[c] - pointB[c]);
+    return distance;
+}
+
+PaletteQuantizer::PaletteQuantizer(int maxColors, bool dither)
+{
+    this->maxColors = std::max(2, std::min(maxColors, 256));
+    this->dither = dither;
+}
+
+int PaletteQuantizer::paletteSize()
+{
+    return colorTable.count();
+}
+
+// Mean squared error per premultiplied channel of the last quantized image
+double PaletteQuantizer::meanSquaredError()
+{
+    return channelCount > 0 ? squaredError / channelCount : 0;
+}
+
+double PaletteQuantizer::peakSignalToNoiseRatio()
+{
+    double mse = meanSquaredError();
+    if (mse <= 0)
+        return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+/// Builds the palette with median cut over the histogram of premultiplied colors.
+/// Fully transparent pixels get a dedicated palette entry so they never bleed color.
+void PaletteQuantizer::buildPalette(const QImage &image)
+{
+    QHash<QRgb, int> histogram;
+    bool hasTransparent = false;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+        {
+            if (qAlpha(line[x]) == 0)
+                hasTransparent = true;
+            else
+                histogram[line[x]]++;
+        }
+    }
+
+    QList<PaletteColor> colors;
+    for (auto it = histogram.constBegin(); it != histogram.constEnd(); ++it)
+    {
+        PaletteColor color;
+        toPoint(it.key(), color.channels);
+        color.count = it.value();
+        colors.append(color);
+    }
+
+    int boxBudget = maxColors - (hasTransparent ? 1 : 0);
+    QList<QPair<int, int>> boxes;
+    if (!colors.isEmpty())
+        boxes.append(qMakePair(0, colors.count()));
+
+    while (boxes.count() < boxBudget)
+    {
+        // Split the box with the widest channel range
+        int splitBox = -1;
+        int splitAxis = 0;
+        int widestRange = 0;
+        for (int b = 0; b < boxes.count(); ++b)
+        {
+            if (boxes[b].second - boxes[b].first < 2)
+                continue;
+
+            for (int c = 0; c < 4; ++c)
+            {
+                int low = 255, high = 0;
+                for (int i = boxes[b].first; i < boxes[b].second; ++i)
+                {
+                    low = std::min(low, colors[i].channels[c]);
+                    high = std::max(high, colors[i].channels[c]);
+                }
+
+                if (high - low > widestRange)
+                {
+                    widestRange = high - low;
+                    splitBox = b;
+                    splitAxis = c;
+                }
+            }
+        }
+
+        if (splitBox == -1)
+            break;
+
+        int begin = boxes[splitBox].first;
+        int end = boxes[splitBox].second;
+        std::sort(colors.begin() + begin, colors.begin() + end, [splitAxis](const PaletteColor &colorA, const PaletteColor &colorB)
+        {
+            return colorA.channels[splitAxis] < colorB.channels[splitAxis];
+        });
+
+        // Split at the weighted median, keeping at least one color on each side
+        qint64 total = 0;
+        for (int i = begin; i < end; ++i)
+            total += colors[i].count;
+
+        qint64 running = 0;
+        int median = begin + 1;
+        for (int i = begin; i < end - 1; ++i)
+        {
+            running += colors[i].count;
+            median = i + 1;
+            if (running * 2 >= total)
+                break;
+        }
+
+        boxes[splitBox].second = median;
+        boxes.append(qMakePair(median, end));
+    }
+
+    colorTable.clear();
+    palette.clear();
+    if (hasTransparent)
+        colorTable.append(qRgba(0, 0, 0, 0));
+
+    for (const QPair<int, int> &box : boxes)
+    {
+        qint64 sums[4] = { 0, 0, 0, 0 };
+        qint64 count = 0;
+        for (int i = box.first; i < box.second; ++i)
+        {
+            for (int c = 0; c < 4; ++c)
+                sums[c] += (qint64)colors[i].channels[c] * colors[i].count;
+            count += colors[i].count;
+        }
+
+        int alpha = (int)((sums[3] + count / 2) / count);
+        if (alpha == 0)
+        {
+            colorTable.append(qRgba(0, 0, 0, 0));
+            continue;
+        }
+
+        int rgb[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            int premultiplied = (int)((sums[c] + count / 2) / count);
+            rgb[c] = std::min(255, (premultiplied * 255 + alpha / 2) / alpha);
+        }
+        colorTable.append(qRgba(rgb[0], rgb[1], rgb[2], alpha));
+    }
+
+    // Search against the colors that are actually written, so reported error matches the output
+    for (int i = 0; i < colorTable.count(); ++i)
+    {
+        PaletteColor color;
+        toPoint(colorTable[i], color.channels);
+        color.count = 0;
+        palette.append(color);
+    }
+}
+
+/// Builds a balanced k-d tree over palette[indices[begin..end)], cycling through the four channels.
+/// @return The index of the subtree root in the tree list.
+int PaletteQuantizer::buildTree(QList<int> &indices, int begin, int end, int depth)
+{
+    if (begin >= end)
+        return -1;
+
+    int axis = depth % 4;
+    int middle = (begin + end) / 2;
+    std::nth_element(indices.begin() + begin, indices.begin() + middle, indices.begin() + end, [this, axis](int a, int b)
+    {
+        return palette[a].channels[axis] < palette[b].channels[axis];
+    });
+
+    PaletteNode node;
+    node.paletteIndex = indices[middle];
+    node.axis = axis;
+    int nodeIndex = tree.count();
+    tree.append(node);
+
+    int left = buildTree(indices, begin, middle, depth + 1);
+    int right = buildTree(indices, middle + 1, end, depth + 1);
+    tree[nodeIndex].left = left;
+    tree[nodeIndex].right = right;
+    return nodeIndex;
+}
+
+void PaletteQuantizer::findNearest(int nodeIndex, const int point[4], int &bestIndex, int &bestDistance) const
+{
+    if (nodeIndex == -1)
+        return;
+
+    const PaletteNode &node = tree[nodeIndex];
+    const int *nodePoint = palette[node.paletteIndex].channels;
+    int distance = squaredDistance(point, nodePoint);
+    if (distance < bestDistance || (distance == bestDistance && node.paletteIndex < bestIndex))
+    {
+        bestDistance = distance;
+        bestIndex = node.paletteIndex;
+    }
+
+    int delta = point[node.axis] - nodePoint[node.axis];
+    int nearChild = delta < 0 ? node.left : node.right;
+    int farChild = delta < 0 ? node.right : node.left;
+    findNearest(nearChild, point, bestIndex, bestDistance);
+    if (delta * delta <= bestDistance)
+        findNearest(farChild, point, bestIndex, bestDistance);
+}
+
+void PaletteQuantizer::quantizeTile(const QImage &image, uchar *bits, int bytesPerLine, QuantizeTile &tile) const
+{
+    // Without dithering equal colors always map to the same entry, so remember the lookups
+    QHash<QRgb, int> cache;
+    tile.squaredError = 0;
+
+    for (int y = tile.rect.top(); y <= tile.rect.bottom(); ++y)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        uchar *indexLine = bits + (qint64)y * bytesPerLine;
+        for (int x = tile.rect.left(); x <= tile.rect.right(); ++x)
+        {
+            QRgb color = line[x];
+            int point[4];
+            toPoint(color, point);
+
+            int bestIndex = -1;
+            if (!dither)
+                bestIndex = cache.value(color, -1);
+
+            if (bestIndex == -1)
+            {
+                int target[4] = { point[0], point[1], point[2], point[3] };
+                if (dither && point[3] > 0)
+                {
+                    int offset = (bayerMatrix[y & 3][x & 3] * 2 - 15) * ditherSpread * point[3] / (32 * 255);
+                    for (int c = 0; c < 3; ++c)
+                        target[c] = qBound(0, target[c] + offset, point[3]);
+                }
+
+                int bestDistance = std::numeric_limits<int>::max();
+                findNearest(treeRoot, target, bestIndex, bestDistance);
+                if (!dither)
+                    cache.insert(color, bestIndex);
+            }
+
+            indexLine[x] = (uchar)bestIndex;
+            tile.squaredError += squaredDistance(point, palette[bestIndex].channels);
+        }
+    }
+}
+
+/// Quantizes the image to at most maxColors colors.
+/// @return An indexed image whose color table carries alpha, which Qt writes as a palette PNG with transparency.
+QImage PaletteQuantizer::quantize(const QImage &image)
+{
+    QImage source = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    buildPalette(source);
+
+    QList<int> indices;
+    for (int i = 0; i < palette.count(); ++i)
+        indices.append(i);
+    tree.clear();
+    treeRoot = buildTree(indices, 0, indices.count(), 0);
+
+    QImage indexed(source.width(), source.height(), QImage::Format_Indexed8);
+    indexed.setColorTable(colorTable);
+
+    QList<QuantizeTile> tiles;
+    for (int y = 0; y < source.height(); y += tileSize)
+    {
+        for (int x = 0; x < source.width(); x += tileSize)
+        {
+            QuantizeTile tile;
+            tile.rect = QRect(x, y, std::min(tileSize, source.width() - x), std::min(tileSize, source.height() - y));
+            tiles.append(tile);
+        }
+    }
+
+    // Fetch the pixel pointer once, tiles write disjoint regions of it
+    uchar *bits = indexed.bits();
+    int bytesPerLine = indexed.bytesPerLine();
+    QtConcurrent::blockingMap(tiles, [this, &source, bits, bytesPerLine](QuantizeTile &tile)
+    {
+        quantizeTile(source, bits, bytesPerLine, tile);
+    });
+
+    squaredError = 0;
+    for (const QuantizeTile &tile : tiles)
+        squaredError += tile.squaredError;
+    channelCount = (qint64)source.width() * source.height() * 4;
+
+    return indexed;
+}
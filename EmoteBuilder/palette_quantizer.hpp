@@ -0,0 +1,60 @@
+#ifndef PALETTE_QUANTIZER_HPP
+#define PALETTE_QUANTIZER_HPP
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QVector>
+
+class PaletteColor
+{
+public:
+    int             channels[4];
+    int             count;
+};
+
+class PaletteNode
+{
+public:
+    int             paletteIndex;
+    int             axis;
+    int             left = -1;
+    int             right = -1;
+};
+
+class QuantizeTile
+{
+public:
+    QRect           rect;
+    double          squaredError = 0;
+};
+
+/// Reduces an ARGB32 image to an 8-bit palettized image.
+/// The palette is built with median cut in premultiplied RGBA space, so colors that are nearly transparent count
+/// for less than opaque ones, and pixels are mapped to the palette through a k-d tree, one tile per worker.
+class PaletteQuantizer
+{
+public:
+    PaletteQuantizer(int maxColors, bool dither);
+    QImage quantize(const QImage &image);
+    int paletteSize();
+    double meanSquaredError();
+    double peakSignalToNoiseRatio();
+
+private:
+    void buildPalette(const QImage &image);
+    int buildTree(QList<int> &indices, int begin, int end, int depth);
+    void findNearest(int nodeIndex, const int point[4], int &bestIndex, int &bestDistance) const;
+    void quantizeTile(const QImage &image, uchar *bits, int bytesPerLine, QuantizeTile &tile) const;
+
+    int                 maxColors = 256;
+    bool                dither = false;
+    QVector<QRgb>       colorTable;
+    QList<PaletteColor> palette;
+    QList<PaletteNode>  tree;
+    int                 treeRoot = -1;
+    double              squaredError = 0;
+    qint64              channelCount = 0;
+};
+
+#endif // PALETTE_QUANTIZER_HPP
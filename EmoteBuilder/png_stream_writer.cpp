@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <QtEndian>
+#include "png_stream_writer.hpp"
+
+#ifdef EMOTE_BUILDER_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+// The zlib stream of a compressed image, empty without zlib
+class PngDeflater
+{
+public:
+#ifdef EMOTE_BUILDER_HAS_ZLIB
+    PngDeflater()
+    {
+        deflateInit(&stream, Z_DEFAULT_COMPRESSION);
+    }
+
+    ~PngDeflater()
+    {
+        deflateEnd(&stream);
+    }
+
+    z_stream        stream = {};
+#endif
+};
+
+static const char pngSignature[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+
+// CRC-32 of a chunk's type and data, with the table built on first use
+static quint32 crc32(const char *data, qint64 size)
+{
+    static const std::array<quint32, 256> table = []()
+    {
+        std::array<quint32, 256> entries;
+        for (quint32 n = 0; n < 256; ++n)
+        {
+            quint32 c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+        return entries;
+    }();
+
+    quint32 crc = 0xffffffffu;
+    for (qint64 i = 0; i < size; ++i)
+        crc = table[(crc ^ (uchar)data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void appendBigEndian(QByteArray &data, quint32 value)
+{
+    char bytes[4];
+    qToBigEndian(value, bytes);
+    data.append(bytes, 4);
+}
+
+PngStreamWriter::PngStreamWriter()
+{
+}
+
+// Out of line, where PngDeflater is complete
+PngStreamWriter::~PngStreamWriter()
+{
+}
+
+// Whether the build has zlib to write compressed images with
+bool PngStreamWriter::canCompress()
+{
+#ifdef EMOTE_BUILDER_HAS_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Deflates the image data at zlib's default level instead of storing it, ignored without zlib. Takes effect on open.
+void PngStreamWriter::setCompressed(bool compressed)
+{
+    this->compressed = compressed && canCompress();
+}
+
+bool PngStreamWriter::open(const QString &path, int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    device = &file;
+    start();
+    return true;
+}
+
+/// Writes to an open device instead of a file, such as a buffer or a counter that measures the encoded size.
+bool PngStreamWriter::open(QIODevice *device, int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    this->device = device;
+    if (!device || !device->isOpen())
+        return false;
+
+    start();
+    return true;
+}
+
+void PngStreamWriter::start()
+{
+    rowsWritten = 0;
+    pending.clear();
+    adlerA = 1;
+    adlerB = 0;
+    streamStarted = false;
+
+    deflater.reset(compressed ? new PngDeflater() : nullptr);
+
+    QByteArray header;
+    appendBigEndian(header, (quint32)width);
+    appendBigEndian(header, (quint32)height);
+    header.append((char)8); // Bit depth
+    header.append((char)6); // RGBA
+    header.append((char)0); // Deflate
+    header.append((char)0); // Adaptive filtering
+    header.append((char)0); // Not interlaced
+
+    device->write(pngSignature, sizeof(pngSignature));
+    writeChunk("IHDR", header);
+}
+
+/// Appends rows below the ones written so far. Pixels may be released as soon as this returns.
+void PngStreamWriter::writeRows(const uint32_t *pixels, int rowCount, ptrdiff_t stride)
+{
+    for (int y = 0; y < rowCount && rowsWritten < height; ++y, ++rowsWritten)
+    {
+        const uint32_t *line = pixels + y * stride;
+        int offset = pending.size();
+        pending.resize(offset + 1 + width * 4);
+        uchar *out = reinterpret_cast<uchar *>(pending.data()) + offset;
+        *out++ = 0; // Filter type none
+        for (int x = 0; x < width; ++x)
+        {
+            uint32_t pixel = line[x];
+            *out++ = (uchar)(pixel >> 16);
+            *out++ = (uchar)(pixel >> 8);
+            *out++ = (uchar)pixel;
+            *out++ = (uchar)(pixel >> 24);
+        }
+
+        if (pending.size() >= maxBlockBytes)
+            flushBlocks(false);
+    }
+}
+
+/// Writes the remaining rows and the end of the image, missing rows are left transparent.
+/// @return False if the file could not be written.
+bool PngStreamWriter::close()
+{
+    if (rowsWritten < height)
+    {
+        std::vector<uint32_t> empty(width, 0);
+        while (rowsWritten < height)
+            writeRows(empty.data(), 1, 0);
+    }
+
+    flushBlocks(true);
+    writeChunk("IEND", QByteArray());
+    return device != &file || file.commit();
+}
+
+QString PngStreamWriter::errorString() const
+{
+    return device ? device->errorString() : file.errorString();
+}
+
+void PngStreamWriter::writeChunk(const char *type, const QByteArray &data)
+{
+    QByteArray chunk;
+    appendBigEndian(chunk, (quint32)data.size());
+    chunk.append(type, 4);
+    chunk.append(data);
+    appendBigEndian(chunk, crc32(chunk.constData() + 4, chunk.size() - 4));
+    device->write(chunk);
+}
+
+/// Wraps the pending bytes into stored deflate blocks, one IDAT chunk each. The final call ends the zlib stream with
+/// a last block and the Adler-32 checksum of all image data.
+void PngStreamWriter::flushBlocks(bool final)
+{
+    if (deflater)
+    {
+        deflateBlocks(final);
+        return;
+    }
+
+    int begin = 0;
+    while (pending.size() - begin >= maxBlockBytes || (final && begin <= pending.size()))
+    {
+        int length = std::min(maxBlockBytes, pending.size() - begin);
+        bool last = final && begin + length == pending.size();
+        const uchar *bytes = reinterpret_cast<const uchar *>(pending.constData()) + begin;
+
+        // Adler-32 sums stay below 2^32 for 5552 bytes between reductions
+        for (int i = 0; i < length; i += 5552)
+        {
+            int end = std::min(length, i + 5552);
+            for (int j = i; j < end; ++j)
+            {
+                adlerA += bytes[j];
+                adlerB += adlerA;
+            }
+            adlerA %= 65521;
+            adlerB %= 65521;
+        }
+
+        QByteArray data;
+        if (!streamStarted)
+        {
+            data.append((char)0x78); // Deflate with a 32K window
+            data.append((char)0x01); // No preset dictionary, fastest
+            streamStarted = true;
+        }
+        data.append((char)(last ? 1 : 0));
+        data.append((char)(length & 0xff));
+        data.append((char)(length >> 8));
+        data.append((char)(~length & 0xff));
+        data.append((char)((~length >> 8) & 0xff));
+        data.append(reinterpret_cast<const char *>(bytes), length);
+        if (last)
+            appendBigEndian(data, (adlerB << 16) | adlerA);
+        writeChunk("IDAT", data);
+
+        begin += length;
+        if (last)
+            break;
+    }
+
+    pending.remove(0, begin);
+}
+
+/// Deflates every pending byte and writes the output in IDAT chunks of up to 64K, zlib keeps the rest of its output
+/// and its window between calls. The final call finishes the zlib stream.
+void PngStreamWriter::deflateBlocks(bool final)
+{
+#ifdef EMOTE_BUILDER_HAS_ZLIB
+    QByteArray data;
+    data.resize(maxBlockBytes);
+    z_stream &stream = deflater->stream;
+    stream.next_in = reinterpret_cast<Bytef *>(pending.data());
+    stream.avail_in = (uInt)pending.size();
+
+    int status = Z_OK;
+    do
+    {
+        stream.next_out = reinterpret_cast<Bytef *>(data.data());
+        stream.avail_out = (uInt)data.size();
+        status = deflate(&stream, final ? Z_FINISH : Z_NO_FLUSH);
+
+        int length = data.size() - (int)stream.avail_out;
+        if (length > 0)
+            writeChunk("IDAT", data.left(length));
+    }
+    while (status != Z_STREAM_END && status != Z_STREAM_ERROR && (final || stream.avail_out == 0));
+
+    pending.clear();
+    if (final)
+        deflater.reset();
+#else
+    Q_UNUSED(final);
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef PNG_STREAM_WRITER_HPP
+#define PNG_STREAM_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <QByteArray>
+#include <QIODevice>
+#include <QSaveFile>
+#include <QString>
+
+class PngDeflater;
+
+/// Writes an 8-bit RGBA PNG a band of rows at a time, so an image never has to be in memory as a whole. By default the
+/// image data is deflated into stored blocks, the same encoding Qt's writer produces at quality 100, which needs no
+/// compression library. Compressed output needs the build to find zlib. Rows are 32-bit ARGB as in
+/// QImage::Format_ARGB32.
+class PngStreamWriter
+{
+public:
+    PngStreamWriter();
+    ~PngStreamWriter();
+    static bool canCompress();
+    void setCompressed(bool compressed);
+    bool open(const QString &path, int width, int height);
+    bool open(QIODevice *device, int width, int height);
+    void writeRows(const uint32_t *pixels, int rowCount, ptrdiff_t stride);
+    bool close();
+    QString errorString() const;
+
+private:
+    void start();
+    void writeChunk(const char *type, const QByteArray &data);
+    void flushBlocks(bool final);
+    void deflateBlocks(bool final);
+
+    static constexpr int maxBlockBytes = 65535;
+
+    QSaveFile       file;
+    QIODevice       *device = nullptr; // The file, or a device given to open
+    bool            compressed = false;
+    std::unique_ptr<PngDeflater> deflater; // Only while writing compressed
+    int             width = 0, height = 0;
+    int             rowsWritten = 0;
+    QByteArray      pending; // Filtered rows not yet written as a stored block
+    quint32         adlerA = 1, adlerB = 0;
+    bool            streamStarted = false;
+};
+
+#endif // PNG_STREAM_WRITER_HPP
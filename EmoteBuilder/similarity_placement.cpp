@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <QHash>
+#include <QPair>
+#include "similarity_placement.hpp"
+
+/// Hashes the opaque span of every row, from its first to its last visible pixel, sorted so that signatures can be
+/// compared by merging. Deflate matches exact bytes at any distance within its window, so frames that share rows
+/// compress together even when those rows moved, while a slight change of color everywhere shares nothing.
+QList<uint> SimilarityPlacement::signature(const QImage &image)
+{
+    QImage source = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    QList<uint> rowHashes;
+    for (int y = 0; y < source.height(); ++y)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+        int begin = 0, end = source.width();
+        while (begin < end && qAlpha(line[begin]) == 0)
+            ++begin;
+        while (end > begin && qAlpha(line[end - 1]) == 0)
+            --end;
+        if (begin < end)
+            rowHashes.append(qHashBits(line + begin, (end - begin) * sizeof(QRgb)));
+    }
+
+    std::sort(rowHashes.begin(), rowHashes.end());
+    return rowHashes;
+}
+
+// Rows the two frames have in common
+int SimilarityPlacement::sharedRows(const QList<uint> &signatureA, const QList<uint> &signatureB)
+{
+    int shared = 0;
+    int a = 0, b = 0;
+    while (a < signatureA.count() && b < signatureB.count())
+    {
+        if (signatureA[a] == signatureB[b])
+        {
+            shared++;
+            a++;
+            b++;
+        }
+        else if (signatureA[a] < signatureB[b])
+        {
+            a++;
+        }
+        else
+        {
+            b++;
+        }
+    }
+
+    return shared;
+}
+
+/// Moves frames between slots of the same size and orientation.
+/// @return The number of entries whose frame changed.
+int SimilarityPlacement::arrange(Data &atlas, const FrameStore &frames)
+{
+    // Entries that can trade places, keyed by size and orientation
+    QHash<QPair<QPair<int, int>, bool>, QList<int>> groups;
+    for (int i = 0; i < (int)atlas.entries.size(); ++i)
+    {
+        const Entry &entry = atlas.entries[i];
+        groups[qMakePair(qMakePair(entry.w, entry.h), entry.flipped)].append(i);
+    }
+
+    int moved = 0;
+    for (const QList<int> &group : groups)
+    {
+        if (group.count() < 2)
+            continue;
+
+        // Slots in scan order of the saved image, whose first row is the top of the atlas. Entries count y from the
+        // bottom and share their height within a group, so a higher y comes first.
+        QList<int> slotEntries = group;
+        std::sort(slotEntries.begin(), slotEntries.end(), [&atlas](int slotA, int slotB)
+        {
+            const Entry &entryA = atlas.entries[slotA];
+            const Entry &entryB = atlas.entries[slotB];
+            return entryA.y != entryB.y ? entryA.y > entryB.y : entryA.x < entryB.x;
+        });
+
+        QList<int> frameIds;
+        QList<QList<uint>> signatures;
+        for (int slot : group)
+            frameIds.append(atlas.entries[slot].index);
+        std::sort(frameIds.begin(), frameIds.end());
+        for (int id : frameIds)
+            signatures.append(signature(frames.image(id)));
+
+        // Greedy chain to the frame sharing the most rows, ties going to the lower frame ID so frames that share
+        // nothing keep their animation order
+        QList<int> chain;
+        QList<bool> chained;
+        for (int i = 0; i < frameIds.count(); ++i)
+            chained.append(false);
+        int current = 0;
+        for (int step = 0; step < frameIds.count(); ++step)
+        {
+            chain.append(frameIds[current]);
+            chained[current] = true;
+
+            int next = -1;
+            int nextShared = 0;
+            for (int i = 0; i < frameIds.count(); ++i)
+            {
+                if (chained[i])
+                    continue;
+                int shared = sharedRows(signatures[current], signatures[i]);
+                if (next == -1 || shared > nextShared)
+                {
+                    next = i;
+                    nextShared = shared;
+                }
+            }
+            current = next;
+        }
+
+        for (int i = 0; i < slotEntries.count(); ++i)
+        {
+            Entry &entry = atlas.entries[slotEntries[i]];
+            if (entry.index != chain[i])
+            {
+                entry.index = chain[i];
+                moved++;
+            }
+        }
+    }
+
+    return moved;
+}
@@ -0,0 +1,23 @@
+#ifndef SIMILARITY_PLACEMENT_HPP
+#define SIMILARITY_PLACEMENT_HPP
+
+#include <QImage>
+#include <QList>
+#include "atlas_layout.hpp"
+#include "frame_store.hpp"
+
+/// Rearranges the frames of a packed atlas among slots of equal size so that similar frames sit next to each other
+/// in PNG scan order, where deflate finds their repeated rows within its window. The layout itself stays untouched,
+/// only which frame occupies which slot changes. Frames are chained greedily by the rows they share, starting from
+/// the lowest frame ID, and the chain fills the slots from the top left row by row.
+class SimilarityPlacement
+{
+public:
+    static int arrange(Data &atlas, const FrameStore &frames);
+
+private:
+    static QList<uint> signature(const QImage &image);
+    static int sharedRows(const QList<uint> &signatureA, const QList<uint> &signatureB);
+};
+
+#endif // SIMILARITY_PLACEMENT_HPP
@@ -0,0 +1,61 @@
+#include <cstring>
+#include "sparse_frame.hpp"
+
+/// Collects the runs of pixels with non-zero alpha of every row.
+SparseFrame SparseFrame::fromPixels(const FramePixels &frame)
+{
+    SparseFrame sparse;
+    sparse.width = frame.width;
+    sparse.height = frame.height;
+    sparse.rowSpans.reserve(frame.height + 1);
+
+    for (int y = 0; y < frame.height; ++y)
+    {
+        sparse.rowSpans.push_back((int)sparse.spans.size());
+        const uint32_t *line = frame.pixels + y * frame.stride;
+        int x = 0;
+        while (x < frame.width)
+        {
+            while (x < frame.width && (line[x] >> 24) == 0)
+                ++x;
+            if (x == frame.width)
+                break;
+
+            PixelSpan span;
+            span.x = x;
+            span.pixelIndex = (int)sparse.pixels.size();
+            while (x < frame.width && (line[x] >> 24) != 0)
+                sparse.pixels.push_back(line[x++]);
+            span.length = x - span.x;
+            sparse.spans.push_back(span);
+        }
+    }
+    sparse.rowSpans.push_back((int)sparse.spans.size());
+
+    sparse.spans.shrink_to_fit();
+    sparse.pixels.shrink_to_fit();
+    return sparse;
+}
+
+/// Writes the visible pixels into a buffer of the frame's size, which the caller has cleared.
+void SparseFrame::toPixels(uint32_t *pixels, ptrdiff_t stride) const
+{
+    for (int y = 0; y < height; ++y)
+    {
+        uint32_t *line = pixels + y * stride;
+        for (int s = rowSpans[y]; s < rowSpans[y + 1]; ++s)
+            std::memcpy(line + spans[s].x, this->pixels.data() + spans[s].pixelIndex, (size_t)spans[s].length * sizeof(uint32_t));
+    }
+}
+
+// Heap bytes held by the frame
+size_t SparseFrame::byteSize() const
+{
+    return rowSpans.capacity() * sizeof(int) + spans.capacity() * sizeof(PixelSpan) + pixels.capacity() * sizeof(uint32_t);
+}
+
+// The share of the frame's pixels that are visible
+double SparseFrame::coverage() const
+{
+    return width > 0 && height > 0 ? (double)pixels.size() / ((double)width * height) : 0.0;
+}
@@ -0,0 +1,34 @@
+#ifndef SPARSE_FRAME_HPP
+#define SPARSE_FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "atlas_renderer.hpp"
+
+/// A run of visible pixels in one row of a sparse frame, with the index of its first pixel in the packed pixels.
+class PixelSpan
+{
+public:
+    int             x, length;
+    int             pixelIndex;
+};
+
+/// A frame kept as the runs of visible pixels of each row, with fully transparent pixels left out. Sprites that are
+/// mostly transparent take less memory this way, and blitting one writes only its visible pixels over a cleared atlas.
+/// Transparent pixels come back as 0 whatever color they carried, which is invisible in the atlas.
+class SparseFrame
+{
+public:
+    static SparseFrame fromPixels(const FramePixels &frame);
+    void toPixels(uint32_t *pixels, ptrdiff_t stride) const;
+    size_t byteSize() const;
+    double coverage() const;
+
+    int             width = 0, height = 0;
+    std::vector<int> rowSpans; // Index of the first span of each row, and one past the last span at the end
+    std::vector<PixelSpan> spans;
+    std::vector<uint32_t> pixels;
+};
+
+#endif // SPARSE_FRAME_HPP
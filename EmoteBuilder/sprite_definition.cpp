@@ -0,0 +1,161 @@
+#include <QJsonArray>
+#include "atlas_layout.hpp"
+#include "sprite_definition.hpp"
+
+// Same inset as tk2d, keeps bilinear sampling off the texels of neighbouring entries
+static const double uvInset = 0.001;
+
+static QJsonObject vectorJson(double x, double y)
+{
+    QJsonObject vector;
+    vector.insert("x", x);
+    vector.insert("y", y);
+    return vector;
+}
+
+static QJsonObject vectorJson(double x, double y, double z)
+{
+    QJsonObject vector = vectorJson(x, y);
+    vector.insert("z", z);
+    return vector;
+}
+
+// Offset of the sprite's bottom left corner from its pivot, in world units
+static QPointF spriteOrigin(double width, double height, QPoint anchor)
+{
+    double anchorX = (int)width / 2 + anchor.x();
+    double anchorY = (int)height / 2 + anchor.y();
+    return QPointF(-anchorX * SpriteDefinition::unitsPerPixel, -(height - anchorY) * SpriteDefinition::unitsPerPixel);
+}
+
+// The atlas UV at (s, t) across the sprite region of an entry, both from 0 to 1 starting at its bottom left
+static QPointF entryUv(const Entry &entry, int atlasWidth, int atlasHeight, double s, double t)
+{
+    double u0 = entry.x / (double)atlasWidth + uvInset / atlasWidth;
+    double v0 = entry.y / (double)atlasHeight + uvInset / atlasHeight;
+    double u1 = (entry.x + entry.w) / (double)atlasWidth - uvInset / atlasWidth;
+    double v1 = (entry.y + entry.h) / (double)atlasHeight - uvInset / atlasHeight;
+    if (entry.flipped)
+        return QPointF(u0 + (u1 - u0) * t, v1 + (v0 - v1) * s);
+    return QPointF(u0 + (u1 - u0) * s, v0 + (v1 - v0) * t);
+}
+
+static void computeBounds(SpriteDefinition &definition)
+{
+    QPointF boundsMin(1e32, 1e32), boundsMax(-1e32, -1e32);
+    for (const QPointF &position : definition.positions)
+    {
+        boundsMin = QPointF(std::min(boundsMin.x(), position.x()), std::min(boundsMin.y(), position.y()));
+        boundsMax = QPointF(std::max(boundsMax.x(), position.x()), std::max(boundsMax.y(), position.y()));
+    }
+
+    definition.boundsCenter = QPointF((boundsMin.x() + boundsMax.x()) / 2, (boundsMin.y() + boundsMax.y()) / 2);
+    definition.boundsSize = QPointF(boundsMax.x() - boundsMin.x(), boundsMax.y() - boundsMin.y());
+}
+
+/// Computes positions, UVs and bounds the way tk2dSpriteCollectionBuilder does for a sprite sheet region.
+/// The anchor offsets the pivot from the center of the trimmed frame, in pixels with y pointing down like tk2d anchors.
+/// Rotated entries map sprite x to atlas y from the top of the region down and sprite y to atlas x, matching how
+/// Builder::renderAtlas writes them. With a mesh its polygon replaces the quad.
+SpriteDefinition SpriteDefinition::fromEntry(const Entry &entry, int atlasWidth, int atlasHeight, QPoint anchor, const SpriteMesh *mesh)
+{
+    // Size of the sprite itself, rotated entries are stored with width and height swapped
+    double width = entry.flipped ? entry.h : entry.w;
+    double height = entry.flipped ? entry.w : entry.h;
+    QPointF origin = spriteOrigin(width, height, anchor);
+
+    QList<QPointF> vertices;
+    SpriteDefinition definition;
+    if (mesh && !mesh->vertices.isEmpty())
+    {
+        vertices = mesh->vertices;
+        definition.indices = mesh->indices;
+        definition.complexGeometry = true;
+    }
+    else
+    {
+        vertices = { QPointF(0, 0), QPointF(width, 0), QPointF(0, height), QPointF(width, height) };
+        definition.indices = { 0, 3, 1, 2, 3, 0 };
+    }
+
+    for (const QPointF &vertex : vertices)
+    {
+        definition.positions.append(QPointF(origin.x() + vertex.x() * unitsPerPixel, origin.y() + vertex.y() * unitsPerPixel));
+        definition.uvs.append(entryUv(entry, atlasWidth, atlasHeight, vertex.x() / width, vertex.y() / height));
+    }
+
+    computeBounds(definition);
+    return definition;
+}
+
+/// Builds a split sprite the way tk2d does for split regions, one quad per piece placed where the piece lies in the
+/// frame, so the pieces reassemble the frame around the same pivot as an unsplit sprite.
+/// Regions are the pieces within the frame with rows counted from its top, the entries where they were packed.
+SpriteDefinition SpriteDefinition::fromPieces(const QList<Entry> &entries, const QList<QRect> &regions, QSize frameSize,
+                                              int atlasWidth, int atlasHeight, QPoint anchor)
+{
+    QPointF origin = spriteOrigin(frameSize.width(), frameSize.height(), anchor);
+
+    SpriteDefinition definition;
+    definition.complexGeometry = true;
+    for (int i = 0; i < entries.count(); ++i)
+    {
+        const QRect &region = regions[i];
+        double left = region.x();
+        double bottom = frameSize.height() - region.y() - region.height();
+        int first = definition.positions.count();
+        for (int corner = 0; corner < 4; ++corner)
+        {
+            double s = corner & 1;
+            double t = corner >> 1;
+            QPointF vertex(left + s * region.width(), bottom + t * region.height());
+            definition.positions.append(QPointF(origin.x() + vertex.x() * unitsPerPixel, origin.y() + vertex.y() * unitsPerPixel));
+            definition.uvs.append(entryUv(entries[i], atlasWidth, atlasHeight, s, t));
+        }
+        definition.indices += { first, first + 3, first + 1, first + 2, first + 3, first };
+    }
+
+    computeBounds(definition);
+    return definition;
+}
+
+/// Serializes with the field names of tk2dSpriteDefinition. Frames are trimmed before packing, so the untrimmed
+/// bounds are the trimmed ones.
+QJsonObject SpriteDefinition::toJson() const
+{
+    QPointF uvMin(1e32, 1e32), uvMax(-1e32, -1e32);
+    QJsonArray positionArray, uvArray, indexArray, normalizedUvArray;
+    for (int i = 0; i < positions.count(); ++i)
+    {
+        positionArray.append(vectorJson(positions[i].x(), positions[i].y(), 0));
+        uvArray.append(vectorJson(uvs[i].x(), uvs[i].y()));
+        uvMin = QPointF(std::min(uvMin.x(), uvs[i].x()), std::min(uvMin.y(), uvs[i].y()));
+        uvMax = QPointF(std::max(uvMax.x(), uvs[i].x()), std::max(uvMax.y(), uvs[i].y()));
+    }
+
+    for (const QPointF &uv : uvs)
+    {
+        double deltaU = uvMax.x() - uvMin.x();
+        double deltaV = uvMax.y() - uvMin.y();
+        normalizedUvArray.append(vectorJson(deltaU > 0 ? (uv.x() - uvMin.x()) / deltaU : 0,
+                                            deltaV > 0 ? (uv.y() - uvMin.y()) / deltaV : 0));
+    }
+
+    for (int index : indices)
+        indexArray.append(index);
+
+    QJsonArray bounds;
+    bounds.append(vectorJson(boundsCenter.x(), boundsCenter.y(), 0));
+    bounds.append(vectorJson(boundsSize.x(), boundsSize.y(), 0));
+
+    QJsonObject definitionJson;
+    definitionJson.insert("boundsData", bounds);
+    definitionJson.insert("complexGeometry", complexGeometry);
+    definitionJson.insert("indices", indexArray);
+    definitionJson.insert("normalizedUvs", normalizedUvArray);
+    definitionJson.insert("positions", positionArray);
+    definitionJson.insert("texelSize", vectorJson(unitsPerPixel, unitsPerPixel, 0));
+    definitionJson.insert("untrimmedBoundsData", bounds);
+    definitionJson.insert("uvs", uvArray);
+    return definitionJson;
+}
@@ -0,0 +1,36 @@
+#ifndef SPRITE_DEFINITION_HPP
+#define SPRITE_DEFINITION_HPP
+
+#include <QJsonObject>
+#include <QList>
+#include <QPoint>
+#include <QPointF>
+#include <QRect>
+#include <QSize>
+#include "sprite_mesh.hpp"
+
+class Entry;
+
+/// The final geometry of one frame as tk2d stores it in a tk2dSpriteDefinition, so the game can assign it directly
+/// instead of extracting the frame from the atlas and rebuilding a sprite collection at load.
+/// Positions are in world units around the anchor, UVs address the atlas the entry was packed into.
+class SpriteDefinition
+{
+public:
+    QList<QPointF>  positions;
+    QList<QPointF>  uvs;
+    QList<int>      indices;
+    QPointF         boundsCenter;
+    QPointF         boundsSize;
+    bool            complexGeometry = false;
+
+    static SpriteDefinition fromEntry(const Entry &entry, int atlasWidth, int atlasHeight, QPoint anchor, const SpriteMesh *mesh);
+    static SpriteDefinition fromPieces(const QList<Entry> &entries, const QList<QRect> &regions, QSize frameSize,
+                                       int atlasWidth, int atlasHeight, QPoint anchor);
+    QJsonObject toJson() const;
+
+    /// World units per pixel, 2 * orthoSize / targetHeight of the sprite collection size the game uses
+    static constexpr double unitsPerPixel = 2.0 * 0.5 / 64;
+};
+
+#endif // SPRITE_DEFINITION_HPP
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include "sprite_mesh.hpp"
+
+static double cross(const QPointF &origin, const QPointF &pointA, const QPointF &pointB)
+{
+    return (pointA.x() - origin.x()) * (pointB.y() - origin.y()) - (pointA.y() - origin.y()) * (pointB.x() - origin.x());
+}
+
+/// Andrew's monotone chain, dropping collinear points.
+/// @return The hull counterclockwise.
+QList<QPointF> MeshBuilder::convexHull(QList<QPointF> points)
+{
+    std::sort(points.begin(), points.end(), [](const QPointF &pointA, const QPointF &pointB)
+    {
+        return pointA.x() < pointB.x() || (pointA.x() == pointB.x() && pointA.y() < pointB.y());
+    });
+
+    QList<QPointF> hull;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        int chainStart = hull.count();
+        for (const QPointF &point : points)
+        {
+            while (hull.count() >= chainStart + 2 && cross(hull[hull.count() - 2], hull.last(), point) <= 0)
+                hull.removeLast();
+            hull.append(point);
+        }
+
+        // The last point of each chain starts the other one
+        hull.removeLast();
+        std::reverse(points.begin(), points.end());
+    }
+
+    return hull;
+}
+
+double MeshBuilder::area(const QList<QPointF> &polygon)
+{
+    double doubleArea = 0;
+    for (int i = 0; i < polygon.count(); ++i)
+    {
+        const QPointF &point = polygon[i];
+        const QPointF &next = polygon[(i + 1) % polygon.count()];
+        doubleArea += point.x() * next.y() - next.x() * point.y();
+    }
+
+    return std::abs(doubleArea) / 2;
+}
+
+/// Removes one vertex from a convex polygon without uncovering anything: an edge is replaced by the point where the
+/// edges before and after it meet, which keeps the polygon convex and only adds the triangle between them. Of all
+/// edges whose meeting point stays within the frame, the one adding the least area goes.
+/// @return False if no edge can be removed.
+bool MeshBuilder::reduce(QList<QPointF> &hull, double width, double height)
+{
+    int count = hull.count();
+    int bestEdge = -1;
+    double bestArea = 0;
+    QPointF bestPoint;
+    for (int i = 0; i < count; ++i)
+    {
+        const QPointF &a = hull[(i + count - 1) % count];
+        const QPointF &b = hull[i];
+        const QPointF &c = hull[(i + 1) % count];
+        const QPointF &d = hull[(i + 2) % count];
+
+        // Solve b + t * (b - a) = c + s * (c - d) for t, s >= 0
+        QPointF directionB = b - a;
+        QPointF directionC = c - d;
+        double denominator = directionB.x() * directionC.y() - directionB.y() * directionC.x();
+        if (std::abs(denominator) < 1e-9)
+            continue;
+
+        QPointF offset = c - b;
+        double t = (offset.x() * directionC.y() - offset.y() * directionC.x()) / denominator;
+        double s = (directionB.x() * offset.y() - directionB.y() * offset.x()) / denominator;
+        if (t < 0 || s < 0)
+            continue;
+
+        QPointF point = b + directionB * t;
+        if (point.x() < -1e-6 || point.y() < -1e-6 || point.x() > width + 1e-6 || point.y() > height + 1e-6)
+            continue;
+
+        double addedArea = std::abs(cross(b, point, c)) / 2;
+        if (bestEdge == -1 || addedArea < bestArea)
+        {
+            bestEdge = i;
+            bestArea = addedArea;
+            bestPoint = QPointF(qBound(0.0, point.x(), width), qBound(0.0, point.y(), height));
+        }
+    }
+
+    if (bestEdge == -1)
+        return false;
+
+    hull[bestEdge] = bestPoint;
+    hull.removeAt((bestEdge + 1) % count);
+    return true;
+}
+
+/// Takes the convex hull of the pixel corners of each row's visible span and merges edges until at most maxVertices
+/// are left. If the hull can't get that small inside the frame, the mesh is the frame quad, so maxVertices must be at
+/// least 4.
+/// @return An empty mesh for a fully transparent frame.
+SpriteMesh MeshBuilder::build(const QImage &image, int maxVertices)
+{
+    QImage source = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+    double width = source.width();
+    double height = source.height();
+
+    QList<QPointF> corners;
+    for (int y = 0; y < source.height(); ++y)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+        int left = 0, right = source.width() - 1;
+        while (left <= right && qAlpha(line[left]) == 0)
+            left++;
+        while (right >= left && qAlpha(line[right]) == 0)
+            right--;
+        if (left > right)
+            continue;
+
+        // Rows count from the bottom in the mesh
+        double bottom = height - y - 1;
+        corners << QPointF(left, bottom) << QPointF(left, bottom + 1)
+                << QPointF(right + 1, bottom) << QPointF(right + 1, bottom + 1);
+    }
+
+    SpriteMesh mesh;
+    if (corners.isEmpty())
+        return mesh;
+
+    mesh.vertices = convexHull(corners);
+    while (mesh.vertices.count() > std::max(maxVertices, 3))
+    {
+        if (!reduce(mesh.vertices, width, height))
+            break;
+    }
+
+    if (mesh.vertices.count() > maxVertices)
+        mesh.vertices = { QPointF(0, 0), QPointF(width, 0), QPointF(width, height), QPointF(0, height) };
+
+    // Fan around the first vertex, reversed from the counterclockwise hull
+    for (int i = 1; i + 1 < mesh.vertices.count(); ++i)
+        mesh.indices << 0 << i + 1 << i;
+
+    mesh.area = area(mesh.vertices);
+    return mesh;
+}
@@ -0,0 +1,31 @@
+#ifndef SPRITE_MESH_HPP
+#define SPRITE_MESH_HPP
+
+#include <QImage>
+#include <QList>
+#include <QPointF>
+
+/// A convex polygon around the visible pixels of a frame, in pixels from the bottom left of the trimmed frame.
+/// Triangles index vertices clockwise, which is front facing in Unity.
+class SpriteMesh
+{
+public:
+    QList<QPointF>  vertices;
+    QList<int>      indices;
+    double          area = 0;
+};
+
+/// Builds sprite meshes that cover every pixel with nonzero alpha, so drawing them instead of the full quad skips
+/// most transparent pixels without clipping any visible one.
+class MeshBuilder
+{
+public:
+    static SpriteMesh build(const QImage &image, int maxVertices);
+
+private:
+    static QList<QPointF> convexHull(QList<QPointF> points);
+    static bool reduce(QList<QPointF> &hull, double width, double height);
+    static double area(const QList<QPointF> &polygon);
+};
+
+#endif // SPRITE_MESH_HPP
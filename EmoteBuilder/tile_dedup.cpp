@@ -0,0 +1,175 @@
+#include <cstring>
+#include "tile_dedup.hpp"
+
+TileDeduplicator::TileDeduplicator(int tileSize)
+{
+    size = std::max(tileSize, 1);
+}
+
+static bool isTransparent(const QImage &tile)
+{
+    for (int y = 0; y < tile.height(); ++y)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb *>(tile.constScanLine(y));
+        for (int x = 0; x < tile.width(); ++x)
+        {
+            if (qAlpha(line[x]) != 0)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool samePixels(const QImage &tileA, const QImage &tileB)
+{
+    int rowBytes = tileA.width() * 4;
+    for (int y = 0; y < tileA.height(); ++y)
+    {
+        if (std::memcmp(tileA.constScanLine(y), tileB.constScanLine(y), rowBytes) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+// @return The index of the unique tile with the same pixels, added if there is none yet
+int TileDeduplicator::findOrAdd(const QImage &tile)
+{
+    uint hash = 0;
+    for (int y = 0; y < tile.height(); ++y)
+        hash = qHashBits(tile.constScanLine(y), tile.width() * 4, hash);
+
+    QList<int> &candidates = tilesByHash[hash];
+    for (int candidate : candidates)
+    {
+        if (samePixels(tiles[candidate], tile))
+            return candidate;
+    }
+
+    candidates.append(tiles.count());
+    tiles.append(tile);
+    return tiles.count() - 1;
+}
+
+/// Splits a trimmed frame into tiles. Edge tiles are padded with transparent pixels to the full tile size.
+void TileDeduplicator::addFrame(int index, const QImage &image)
+{
+    QImage source = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    TileMap map;
+    map.index = index;
+    map.width = source.width();
+    map.height = source.height();
+    map.columns = (source.width() + size - 1) / size;
+    map.rows = (source.height() + size - 1) / size;
+    for (int row = 0; row < map.rows; ++row)
+    {
+        for (int column = 0; column < map.columns; ++column)
+        {
+            // Copying outside the image fills with zeroes, which is transparent in ARGB32
+            QImage tile = source.copy(column * size, row * size, size, size);
+            totalTiles++;
+            if (isTransparent(tile))
+            {
+                emptyTiles++;
+                map.tiles.append(-1);
+            }
+            else
+            {
+                map.tiles.append(findOrAdd(tile));
+            }
+        }
+    }
+
+    maps.append(map);
+}
+
+/// Picks the smallest power of two atlas that holds every unique tile, growing width and height in turn.
+/// @return False if the tiles don't fit in maxWidth x maxHeight.
+bool TileDeduplicator::layout(int maxWidth, int maxHeight)
+{
+    int cell = size + 2;
+    atlasWidth = 1;
+    atlasHeight = 1;
+    while (true)
+    {
+        columns = atlasWidth / cell;
+        if (columns > 0 && (qint64)columns * (atlasHeight / cell) >= tiles.count())
+            return true;
+
+        if (atlasWidth >= maxWidth && atlasHeight >= maxHeight)
+            return false;
+
+        if ((atlasWidth <= atlasHeight && atlasWidth < maxWidth) || atlasHeight >= maxHeight)
+            atlasWidth *= 2;
+        else
+            atlasHeight *= 2;
+    }
+}
+
+// Top left of the tile's pixels in the atlas, inside its extruded cell
+QPoint TileDeduplicator::tilePosition(int tile) const
+{
+    int cell = size + 2;
+    return QPoint((tile % columns) * cell + 1, (tile / columns) * cell + 1);
+}
+
+QImage TileDeduplicator::render() const
+{
+    QImage atlas(atlasWidth, atlasHeight, QImage::Format_ARGB32);
+    atlas.fill(Qt::transparent);
+
+    for (int i = 0; i < tiles.count(); ++i)
+    {
+        const QImage &tile = tiles[i];
+        QPoint position = tilePosition(i);
+
+        // Rows from one above to one below the tile, clamped to its edge rows, and each row extruded left and right
+        for (int y = -1; y <= size; ++y)
+        {
+            const QRgb *source = reinterpret_cast<const QRgb *>(tile.constScanLine(qBound(0, y, size - 1)));
+            QRgb *target = reinterpret_cast<QRgb *>(atlas.scanLine(position.y() + y)) + position.x();
+            std::memcpy(target, source, size * 4);
+            target[-1] = source[0];
+            target[size] = source[size - 1];
+        }
+    }
+
+    return atlas;
+}
+
+const QList<TileMap> &TileDeduplicator::tileMaps() const
+{
+    return maps;
+}
+
+int TileDeduplicator::tileSize() const
+{
+    return size;
+}
+
+int TileDeduplicator::tileCount() const
+{
+    return totalTiles;
+}
+
+int TileDeduplicator::uniqueTileCount() const
+{
+    return tiles.count();
+}
+
+int TileDeduplicator::emptyTileCount() const
+{
+    return emptyTiles;
+}
+
+int TileDeduplicator::width() const
+{
+    return atlasWidth;
+}
+
+int TileDeduplicator::height() const
+{
+    return atlasHeight;
+}
@@ -0,0 +1,51 @@
+#ifndef TILE_DEDUP_HPP
+#define TILE_DEDUP_HPP
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QPoint>
+
+/// A frame described as a grid of tiles, row by row from its top left. Fully transparent tiles are -1.
+class TileMap
+{
+public:
+    int             index;
+    int             width, height;
+    int             columns, rows;
+    QList<int>      tiles;
+};
+
+/// Splits frames into square tiles and keeps a single copy of every distinct tile, so frames that differ only in a
+/// small region share the rest of their pixels. Tiles are found by hash and confirmed pixel by pixel, then laid out
+/// on a grid whose cells extrude each tile by one pixel, so filtering at tile seams samples the tile's own edge.
+class TileDeduplicator
+{
+public:
+    TileDeduplicator(int tileSize);
+    void addFrame(int index, const QImage &image);
+    bool layout(int maxWidth, int maxHeight);
+    QImage render() const;
+    QPoint tilePosition(int tile) const;
+    const QList<TileMap> &tileMaps() const;
+    int tileSize() const;
+    int tileCount() const;
+    int uniqueTileCount() const;
+    int emptyTileCount() const;
+    int width() const;
+    int height() const;
+
+private:
+    int findOrAdd(const QImage &tile);
+
+    int                     size = 16;
+    int                     totalTiles = 0;
+    int                     emptyTiles = 0;
+    int                     columns = 0;
+    int                     atlasWidth = 0, atlasHeight = 0;
+    QList<QImage>           tiles;
+    QHash<uint, QList<int>> tilesByHash;
+    QList<TileMap>          maps;
+};
+
+#endif // TILE_DEDUP_HPP
@@ -8,7 +8,96 @@ namespace XPressions
     public class AnimationDefinition
     {
         public Vector2[] anchors;
-        public Entry[] entries;
+        public SpriteEntry[] entries;
         public int fps;
     }
+
+    /// <summary>
+    /// The final tk2d geometry of a frame as computed by the builder, with positions around the anchor and UVs into the atlas.
+    /// </summary>
+    [Serializable]
+    public class PrebuiltSprite
+    {
+        public Vector3[] boundsData;
+        public bool complexGeometry;
+        public int[] indices;
+        public Vector2[] normalizedUvs;
+        public Vector3[] positions;
+        public Vector3 texelSize;
+        public Vector3[] untrimmedBoundsData;
+        public Vector2[] uvs;
+
+        public tk2dSpriteDefinition ToDefinition(string name, Entry entry, Material material, int materialId)
+        {
+            return new tk2dSpriteDefinition
+            {
+                boundsData = boundsData,
+                colliderIndicesBack = new int[] { },
+                colliderIndicesFwd = new int[] { },
+                colliderVertices = new Vector3[] { },
+                complexGeometry = complexGeometry,
+                flipped = entry.flipped ? tk2dSpriteDefinition.FlipMode.Tk2d : tk2dSpriteDefinition.FlipMode.None,
+                indices = indices,
+                material = material,
+                materialId = materialId,
+                materialInst = material,
+                name = name,
+                normalizedUvs = normalizedUvs,
+                normals = new Vector3[] { },
+                positions = positions,
+                regionX = entry.x,
+                regionY = entry.y,
+                regionW = entry.w,
+                regionH = entry.h,
+                tangents = new Vector4[] { },
+                texelSize = texelSize,
+                untrimmedBoundsData = untrimmedBoundsData,
+                uvs = uvs,
+            };
+        }
+    }
+
+    /// <summary>
+    /// An atlas entry, with the prebuilt sprite of builds that compute it.
+    /// </summary>
+    [Serializable]
+    public class SpriteEntry : Entry
+    {
+        public PrebuiltSprite sprite;
+    }
+
+    /// <summary>
+    /// An atlas entry of a shared build, which also names the page the frame was packed into.
+    /// </summary>
+    [Serializable]
+    public class PageEntry : SpriteEntry
+    {
+        public int page;
+    }
+
+    [Serializable]
+    public class AtlasPageDefinition
+    {
+        public string file;
+        public int width, height;
+    }
+
+    [Serializable]
+    public class EmoteDefinition
+    {
+        public string name;
+        public Vector2[] anchors;
+        public PageEntry[] entries;
+        public int fps;
+    }
+
+    /// <summary>
+    /// The emotes.json layout written by a shared build: a few atlas pages, and per emote the page and region of each frame.
+    /// </summary>
+    [Serializable]
+    public class SharedAtlasDefinition
+    {
+        public AtlasPageDefinition[] pages;
+        public EmoteDefinition[] emotes;
+    }
 }
@@ -62,6 +62,14 @@ namespace XPressions
 
         private void LoadEmotes()
         {
+            // A shared build packs every emote into a few atlas pages described by one layout file
+            string layoutFile = Path.Combine(_emotesDir, "emotes.json");
+            if (File.Exists(layoutFile))
+            {
+                LoadSharedEmotes(layoutFile);
+                return;
+            }
+
             foreach (string emoteDir in Directory.GetDirectories(_emotesDir))
             {
                 string emoteName = Path.GetFileName(emoteDir);
@@ -85,36 +93,6 @@ namespace XPressions
                 };
                 Data.Add(atlasData);
 
-                for (int i = 0; i < atlasData.entries.Length; i++)
-                {
-                    Texture2D subTexture = atlasTexture.SubTexture(atlasData.entries[i]);
-                    subTexture.name = $"{emoteName}_{i:D4}";
-                    
-                    _sourceTextures.Add(subTexture);
-                }
-                
-                List<tk2dSpriteCollectionDefinition> textureParams = new(atlasData.entries.Length);
-                for (int i = 0; i < atlasData.entries.Length; i++)
-                {
-                    var spriteCollectionDefinition = new tk2dSpriteCollectionDefinition
-                    {
-                        anchor = tk2dSpriteCollectionDefinition.Anchor.MiddleCenter,
-                        anchorX = animationDefinition.anchors[i].x,
-                        anchorY = animationDefinition.anchors[i].y,
-                        extractRegion = true,
-                        name = $"{emoteName}_{i:D4}",
-                        pad = tk2dSpriteCollectionDefinition.Pad.Default,
-                        regionX = atlasData.entries[i].x,
-                        regionY = atlasData.entries[i].y,
-                        regionW = atlasData.entries[i].w,
-                        regionH = atlasData.entries[i].h,
-                        source = tk2dSpriteCollectionDefinition.Source.SpriteSheet,
-                        texture = atlasTexture,
-                    };
-
-                    textureParams.Add(spriteCollectionDefinition);
-                }
-                
                 var atlasMaterial = new Material(Shader.Find("Sprites/Default-ColorFlash"))
                 {
                     mainTexture = atlasTexture,
@@ -122,53 +100,6 @@ namespace XPressions
                 };
                 _materials.Add(atlasMaterial);
                 
-                var cln = new tk2dSpriteCollection
-                {
-                    atlasMaterials = new[] { atlasMaterial },
-                    atlasTextures = new[] { atlasTexture },
-                    disableRotation = false,
-                    maxTextureSize = 2048,
-                    //name = emoteName + " Cln",
-                    removeDuplicates = true,
-                    sizeDef = new tk2dSpriteCollectionSize
-                    {
-                        height = 64,
-                        orthoSize = 0.5f,
-                        type = tk2dSpriteCollectionSize.Type.Explicit,
-                    },
-                    textureParams = textureParams.ToArray(),
-                };
-                
-                Mesh mesh = _meshFilter.sharedMesh;
-                for (int i = 0; i < atlasData.entries.Length; i++)
-                {
-                    Entry entry = atlasData.entries[i];
-
-                    var tk2dSpriteDef = new tk2dSpriteDefinition
-                    {
-                        boundsData = new Vector3[2],
-                        colliderIndicesBack = new int[] { },
-                        colliderIndicesFwd = new int[] { },
-                        colliderVertices = new Vector3[] { },
-                        flipped = entry.flipped ? tk2dSpriteDefinition.FlipMode.Tk2d : tk2dSpriteDefinition.FlipMode.None,
-                        indices = new int[mesh.triangles.Length],
-                        material = atlasMaterial,
-                        materialInst = atlasMaterial,
-                        normalizedUvs = new[] { new Vector2(0, 0), new Vector2(0, 1), new Vector2(1, 0), new Vector2(1, 1) },
-                        normals = new Vector3[] { },
-                        positions = new Vector3[mesh.vertices.Length],
-                        regionX = entry.x,
-                        regionY = entry.y,
-                        regionW = entry.w,
-                        regionH = entry.h,
-                        tangents = new Vector4[] { },
-                        untrimmedBoundsData = new Vector3[2],
-                        uvs = new Vector2[mesh.vertices.Length],
-                    };
-
-                    _spriteDefinitions.Add(tk2dSpriteDef);
-                }
-                
                 var dataObj = new GameObject(emoteName + " Cln");
                 var data = dataObj.AddComponent<tk2dSpriteCollectionData>();
                 data.allowMultipleAtlases = false;
@@ -184,10 +115,98 @@ namespace XPressions
                 data.textures = new Texture[] { atlasTexture };
                 dataObj.hideFlags = HideFlags.HideAndDontSave;
 
-                cln.spriteCollection = data;
+                // Builds that carry the final sprite geometry need neither sub-textures nor a collection rebuild
+                if (animationDefinition.entries.All(entry => entry.sprite != null))
+                {
+                    data.spriteDefinitions = animationDefinition.entries
+                        .Select((entry, i) => entry.sprite.ToDefinition($"{emoteName}_{i:D4}", entry, atlasMaterial, 0))
+                        .ToArray();
+                    _spriteDefinitions.AddRange(data.spriteDefinitions);
+                }
+                else
+                {
+                    for (int i = 0; i < atlasData.entries.Length; i++)
+                    {
+                        Texture2D subTexture = atlasTexture.SubTexture(atlasData.entries[i]);
+                        subTexture.name = $"{emoteName}_{i:D4}";
+                    
+                        _sourceTextures.Add(subTexture);
+                    }
                 
-                tk2dSpriteCollectionBuilder.Rebuild(cln);
-                _spriteCollections.Add(cln);
+                    List<tk2dSpriteCollectionDefinition> textureParams = new(atlasData.entries.Length);
+                    for (int i = 0; i < atlasData.entries.Length; i++)
+                    {
+                        var spriteCollectionDefinition = new tk2dSpriteCollectionDefinition
+                        {
+                            anchor = tk2dSpriteCollectionDefinition.Anchor.MiddleCenter,
+                            anchorX = animationDefinition.anchors[i].x,
+                            anchorY = animationDefinition.anchors[i].y,
+                            extractRegion = true,
+                            name = $"{emoteName}_{i:D4}",
+                            pad = tk2dSpriteCollectionDefinition.Pad.Default,
+                            regionX = atlasData.entries[i].x,
+                            regionY = atlasData.entries[i].y,
+                            regionW = atlasData.entries[i].w,
+                            regionH = atlasData.entries[i].h,
+                            source = tk2dSpriteCollectionDefinition.Source.SpriteSheet,
+                            texture = atlasTexture,
+                        };
+
+                        textureParams.Add(spriteCollectionDefinition);
+                    }
+                
+                    var cln = new tk2dSpriteCollection
+                    {
+                        atlasMaterials = new[] { atlasMaterial },
+                        atlasTextures = new[] { atlasTexture },
+                        disableRotation = false,
+                        maxTextureSize = 2048,
+                        //name = emoteName + " Cln",
+                        removeDuplicates = true,
+                        sizeDef = new tk2dSpriteCollectionSize
+                        {
+                            height = 64,
+                            orthoSize = 0.5f,
+                            type = tk2dSpriteCollectionSize.Type.Explicit,
+                        },
+                        textureParams = textureParams.ToArray(),
+                    };
+                
+                    Mesh mesh = _meshFilter.sharedMesh;
+                    for (int i = 0; i < atlasData.entries.Length; i++)
+                    {
+                        Entry entry = atlasData.entries[i];
+
+                        var tk2dSpriteDef = new tk2dSpriteDefinition
+                        {
+                            boundsData = new Vector3[2],
+                            colliderIndicesBack = new int[] { },
+                            colliderIndicesFwd = new int[] { },
+                            colliderVertices = new Vector3[] { },
+                            flipped = entry.flipped ? tk2dSpriteDefinition.FlipMode.Tk2d : tk2dSpriteDefinition.FlipMode.None,
+                            indices = new int[mesh.triangles.Length],
+                            material = atlasMaterial,
+                            materialInst = atlasMaterial,
+                            normalizedUvs = new[] { new Vector2(0, 0), new Vector2(0, 1), new Vector2(1, 0), new Vector2(1, 1) },
+                            normals = new Vector3[] { },
+                            positions = new Vector3[mesh.vertices.Length],
+                            regionX = entry.x,
+                            regionY = entry.y,
+                            regionW = entry.w,
+                            regionH = entry.h,
+                            tangents = new Vector4[] { },
+                            untrimmedBoundsData = new Vector3[2],
+                            uvs = new Vector2[mesh.vertices.Length],
+                        };
+
+                        _spriteDefinitions.Add(tk2dSpriteDef);
+                    }
+                
+                    cln.spriteCollection = data;
+                
+                    tk2dSpriteCollectionBuilder.Rebuild(cln);
+                    _spriteCollections.Add(cln);
+                }
 
                 List<tk2dSpriteAnimationFrame> frames = new();
                 
@@ -220,6 +239,155 @@ namespace XPressions
             }
         }
 
+        private void LoadSharedEmotes(string layoutFile)
+        {
+            var layout = JsonConvert.DeserializeObject<SharedAtlasDefinition>(File.ReadAllText(layoutFile));
+
+            // One texture and one material per page, shared by every emote packed into it
+            List<Texture2D> pageTextures = new(layout.pages.Length);
+            List<Material> pageMaterials = new(layout.pages.Length);
+            int maxPageSize = 0;
+            foreach (AtlasPageDefinition page in layout.pages)
+            {
+                byte[] pageBytes = File.ReadAllBytes(Path.Combine(_emotesDir, page.file));
+                var pageTexture = new Texture2D(2, 2)
+                {
+                    name = Path.GetFileNameWithoutExtension(page.file)
+                };
+                pageTexture.LoadImage(pageBytes);
+                _sourceAtlases.Add(pageTexture);
+                pageTextures.Add(pageTexture);
+                maxPageSize = Mathf.Max(maxPageSize, Mathf.Max(pageTexture.width, pageTexture.height));
+
+                var pageMaterial = new Material(Shader.Find("Sprites/Default-ColorFlash"))
+                {
+                    mainTexture = pageTexture,
+                    name = pageTexture.name + " material",
+                };
+                _materials.Add(pageMaterial);
+                pageMaterials.Add(pageMaterial);
+            }
+
+            // Every frame goes into one sprite collection in emote order, so each clip covers a contiguous range of sprite IDs
+            List<PageEntry> collectionEntries = new();
+            List<tk2dSpriteCollectionDefinition> textureParams = new();
+            foreach (EmoteDefinition emote in layout.emotes)
+            {
+                foreach (PageEntry entry in emote.entries)
+                {
+                    var spriteCollectionDefinition = new tk2dSpriteCollectionDefinition
+                    {
+                        anchor = tk2dSpriteCollectionDefinition.Anchor.MiddleCenter,
+                        anchorX = emote.anchors[entry.index].x,
+                        anchorY = emote.anchors[entry.index].y,
+                        extractRegion = true,
+                        name = $"{emote.name}_{entry.index:D4}",
+                        pad = tk2dSpriteCollectionDefinition.Pad.Default,
+                        regionX = entry.x,
+                        regionY = entry.y,
+                        regionW = entry.w,
+                        regionH = entry.h,
+                        source = tk2dSpriteCollectionDefinition.Source.SpriteSheet,
+                        texture = pageTextures[entry.page],
+                    };
+
+                    textureParams.Add(spriteCollectionDefinition);
+                    collectionEntries.Add(entry);
+                }
+            }
+
+            // The collection builder looks up whether a region is flipped by its position in the first atlas data
+            Data.Add(new Data
+            {
+                entries = collectionEntries.ToArray(),
+                height = pageTextures[0].height,
+                width = pageTextures[0].width,
+            });
+
+            var dataObj = new GameObject("Shared Emotes Cln");
+            var data = dataObj.AddComponent<tk2dSpriteCollectionData>();
+            data.allowMultipleAtlases = true;
+            data.buildKey = Random.Range(0, int.MaxValue);
+            data.halfTargetHeight = 32;
+            data.invOrthoSize = 2;
+            data.materials = pageMaterials.ToArray();
+            data.materialInsts = pageMaterials.ToArray();
+            data.materialPngTextureId = Enumerable.Range(0, pageTextures.Count).ToArray();
+            data.spriteCollectionName = "Shared Emotes";
+            data.spriteCollectionPlatformGUIDs = new string[] { };
+            data.spriteCollectionPlatforms = new string[] { };
+            data.textures = pageTextures.ToArray();
+            dataObj.hideFlags = HideFlags.HideAndDontSave;
+
+            // Builds that carry the final sprite geometry need no collection rebuild
+            if (collectionEntries.All(entry => entry.sprite != null))
+            {
+                data.spriteDefinitions = collectionEntries
+                    .Select((entry, i) => entry.sprite.ToDefinition(textureParams[i].name, entry, pageMaterials[entry.page], entry.page))
+                    .ToArray();
+            }
+            else
+            {
+                var cln = new tk2dSpriteCollection
+                {
+                    allowMultipleAtlases = true,
+                    atlasMaterials = pageMaterials.ToArray(),
+                    atlasTextures = pageTextures.ToArray(),
+                    disableRotation = false,
+                    maxTextureSize = maxPageSize,
+                    removeDuplicates = true,
+                    sizeDef = new tk2dSpriteCollectionSize
+                    {
+                        height = 64,
+                        orthoSize = 0.5f,
+                        type = tk2dSpriteCollectionSize.Type.Explicit,
+                    },
+                    textureParams = textureParams.ToArray(),
+                };
+
+                cln.spriteCollection = data;
+
+                tk2dSpriteCollectionBuilder.Rebuild(cln);
+                _spriteCollections.Add(cln);
+            }
+
+            List<tk2dSpriteAnimationClip> clips = new(layout.emotes.Length);
+            int firstSpriteId = 0;
+            foreach (EmoteDefinition emote in layout.emotes)
+            {
+                List<tk2dSpriteAnimationFrame> frames = new(emote.entries.Length);
+                for (int index = 0; index < emote.entries.Length; index++)
+                {
+                    var frame = new tk2dSpriteAnimationFrame
+                    {
+                        spriteCollection = data,
+                        spriteId = firstSpriteId + index,
+                    };
+
+                    frames.Add(frame);
+                }
+                firstSpriteId += emote.entries.Length;
+
+                var clip = new tk2dSpriteAnimationClip
+                {
+                    fps = emote.fps,
+                    frames = frames.ToArray(),
+                    loopStart = 0,
+                    name = emote.name,
+                    wrapMode = tk2dSpriteAnimationClip.WrapMode.Once,
+                };
+
+                clips.Add(clip);
+            }
+
+            var animObj = new GameObject("Shared Emotes Anim");
+            var animation = animObj.AddComponent<tk2dSpriteAnimation>();
+            animation.clips = clips.ToArray();
+            animObj.hideFlags = HideFlags.HideAndDontSave;
+
+            _spriteAnimations.Add(animation);
+        }
+
         private void AddEmotes()    
         {
             //tk2dSpriteCollectionData data = _sprite.Collection;